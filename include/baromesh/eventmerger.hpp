@@ -0,0 +1,76 @@
+#ifndef BAROMESH_EVENTMERGER_HPP
+#define BAROMESH_EVENTMERGER_HPP
+
+#include <baromesh/linkbot.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace barobo {
+
+// One event from one robot, as delivered by EventMerger.
+struct MergedEvent {
+    enum Type { JOINT_ANGLE, JOINT_STATE, ACCELEROMETER };
+    Type type;
+    size_t source;      // as returned by EventMerger::add()
+    int64_t hostTime;   // when the robot sampled it; see EventMerger
+    int timestamp;      // robot time, as in the Linkbot callbacks
+    int joint;          // JOINT_ANGLE and JOINT_STATE
+    double degrees;     // JOINT_ANGLE
+    JointState::Type state;  // JOINT_STATE
+    double accel[3];    // ACCELEROMETER
+};
+
+/* Merges the encoder, joint and accelerometer events of many Linkbots into
+ * one stream, ordered by the host time at which each robot sampled them.
+ * Like a StateObserver, the merger also sees the replies to getters which
+ * report the same quantities.
+ *
+ * Sample times come from each Linkbot's clock estimate (see
+ * Linkbot::toHostTime()), or are the arrival time for an event the robot did
+ * not stamp. Events are queued per robot and merged through a heap, so each
+ * costs O(log robots). An event is handed out once every robot has reported
+ * something at least as new, or once it is window microseconds old, so a
+ * silent robot delays the stream by at most the window. An event which
+ * arrives after a newer one has been handed out is dropped and counted as
+ * late; widen the window if that happens often. */
+class EventMerger {
+public:
+    // Buffer at most capacity events; more are dropped and counted.
+    explicit EventMerger (int64_t windowMicroseconds = 50000, size_t capacity = 65536);
+    // Detaches from every Linkbot still merged, so they must outlive the
+    // merger or be removed first.
+    ~EventMerger ();
+
+private:
+    // noncopyable
+    EventMerger (const EventMerger&);
+    EventMerger& operator= (const EventMerger&);
+
+public:
+    // Start merging linkbot's events, requesting encoder events at the given
+    // granularity in degrees, and return the number which identifies its
+    // events. A few round trips synchronize the robot's clock first. Throws
+    // barobo::Error on failure.
+    size_t add (Linkbot& linkbot, double encoderGranularity = 1.0);
+    // Stop merging source's events. Those already queued are still delivered.
+    void remove (size_t source);
+
+    // Take the next event in order. Waits up to timeoutMs for one to become
+    // ready; returns false if none did.
+    bool next (MergedEvent& event, int timeoutMs = 0);
+
+    size_t queued () const;
+    // Events dropped because they arrived too late, or because the buffer
+    // was full.
+    uint64_t lateEvents () const;
+    uint64_t droppedEvents () const;
+
+private:
+    struct Impl;
+    Impl* m;
+};
+
+} // namespace barobo
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef BAROMESH_FLEET_HPP
+#define BAROMESH_FLEET_HPP
+
+#include <baromesh/linkbot.hpp>
+
+#include <vector>
+#include <stddef.h>
+
+namespace barobo {
+
+/* The latest known state of many robots, kept in one table.
+ *
+ * Each Linkbot added to the table becomes a row, filled from the robot's
+ * event broadcasts and from getter replies (see StateObserver). Columns are
+ * stored as contiguous arrays, one per quantity, so the queries below are
+ * tight loops over a few cache lines and never contact a robot. */
+class FleetTable {
+public:
+    FleetTable ();
+    // Detaches from every Linkbot still in the table, so they must outlive
+    // it or be removed first.
+    ~FleetTable ();
+
+private:
+    // noncopyable
+    FleetTable (const FleetTable&);
+    FleetTable& operator= (const FleetTable&);
+
+public:
+    // Start tracking linkbot and return its row. Encoder events are
+    // requested at the given granularity, in degrees. Throws barobo::Error if
+    // the robot's events cannot be enabled.
+    size_t add (Linkbot& linkbot, double encoderGranularity = 1.0);
+    // Stop tracking the Linkbot in row. The row stays allocated but is no
+    // longer updated or reported by queries.
+    void remove (size_t row);
+
+    size_t size () const;
+
+    // Copy out one row. Quantities which have not been reported yet are 0.
+    void get (size_t row, double angles[3], double accel[3],
+              JointState::Type states[3], double& batteryVoltage) const;
+
+    /* QUERIES */
+    // Each returns the rows matching the condition, in ascending order.
+
+    // Any joint angle with magnitude greater than degrees.
+    std::vector<size_t> jointBeyond (double degrees) const;
+    // Angle between the accelerometer vector and the robot's z axis greater
+    // than degrees.
+    std::vector<size_t> tiltExceeds (double degrees) const;
+    // Any joint in the given state.
+    std::vector<size_t> jointInState (JointState::Type state) const;
+    // Battery voltage known and below volts.
+    std::vector<size_t> batteryBelow (double volts) const;
+
+private:
+    struct Impl;
+    Impl* m;
+};
+
+} // namespace barobo
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef BAROMESH_JOINTHISTORY_HPP
+#define BAROMESH_JOINTHISTORY_HPP
+
+#include <baromesh/linkbot.hpp>
+
+#include <stddef.h>
+
+namespace barobo {
+
+/* Records a fixed-size history of each joint's angle, so that recent motion
+ * can be looked up without a getJointAngles round trip or a buffer of one's
+ * own.
+ *
+ * Samples come from a StateObserver attached to the Linkbot: encoder events,
+ * at the granularity given, and the replies to getJointAngles and
+ * getRobotState. Each joint keeps the newest capacity samples, indexed by
+ * robot timestamp in milliseconds (as in Linkbot::getJointAngles). The robot
+ * only reports an encoder event when the joint has turned by the
+ * granularity, so a finer granularity buys a denser history. */
+class JointHistory {
+public:
+    // Throws barobo::Error if the robot's events cannot be enabled. The
+    // Linkbot must outlive the history.
+    JointHistory (Linkbot& linkbot, size_t capacity = 256,
+                  double encoderGranularity = 1.0);
+    ~JointHistory ();
+
+private:
+    // noncopyable
+    JointHistory (const JointHistory&);
+    JointHistory& operator= (const JointHistory&);
+
+public:
+    // Joints are numbered from 0. All of these return false if the joint has
+    // no samples to answer from.
+
+    // The newest sample.
+    bool getLatestJointAngle (int joint, int& timestamp, double& degrees) const;
+
+    // The joint's angle at robot time timestamp, interpolated linearly between
+    // the samples on either side. False if timestamp is older than the oldest
+    // sample or newer than the newest. O(log capacity).
+    bool getJointAngleAt (int joint, int timestamp, double& degrees) const;
+
+    // The joint's speed in degrees per second: the least-squares slope of the
+    // samples within windowMs of the newest one, and at least the newest two.
+    // If the robot has reported the joint stopped since the newest sample, the
+    // estimate is 0.
+    bool getJointVelocityEstimate (int joint, double& degreesPerSecond,
+                                   int windowMs = 100) const;
+
+    // Forget every sample, e.g., after resetEncoderRevs().
+    void clear ();
+
+private:
+    struct Impl;
+    Impl* m;
+};
+
+} // namespace barobo
+
+#endif
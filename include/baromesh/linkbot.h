@@ -64,6 +64,16 @@ namespace baromesh {
 typedef struct Linkbot Linkbot;
 }
 
+/* ERRORS */
+// Every linkbot* function returning int returns 0 on success and -1 on
+// failure, and the linkbotFrom* constructors return a null pointer on
+// failure. Nothing is printed. Details about the most recent call on the
+// calling thread are available from these two functions. The string returned
+// by linkbotLastError() remains valid until the next linkbot* call on the
+// same thread.
+LIBLINKBOT_EXPORT const char* linkbotLastError();
+LIBLINKBOT_EXPORT int linkbotLastErrorCode();
+
 baromesh::Linkbot* linkbotFromTcpEndpoint(const char* host, const char* service);
 baromesh::Linkbot* linkbotFromSerialId(const char* serialId);
 void linkbotDelete(baromesh::Linkbot* l);
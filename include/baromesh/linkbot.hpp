@@ -3,12 +3,57 @@
 
 #include <baromesh/linkbot.h>
 
+#include <boost/config.hpp>
+#include <boost/system/error_code.hpp>
+
 #include <string>
 #include <vector>
 #include <stdint.h>
 
 namespace barobo {
 
+// A snapshot of a robot's state, as returned by Linkbot::getRobotState(). Each
+// group of fields has a host timestamp: the time, in microseconds on the host's
+// steady clock, at which the robot's reply for that group arrived.
+struct RobotState {
+    int jointAnglesTimestamp; // robot time, as in Linkbot::getJointAngles
+    double jointAngles[3];
+    int64_t jointAnglesHostTime;
+
+    double jointSpeeds[3];
+    int64_t jointSpeedsHostTime;
+
+    JointState::Type jointStates[3];
+    int64_t jointStatesHostTime;
+
+    double accelerometer[3];
+    int64_t accelerometerHostTime;
+
+    double batteryVoltage;
+    int64_t batteryVoltageHostTime;
+
+    int ledColor[3];
+    int64_t ledColorHostTime;
+};
+
+// Receives a robot's state as it arrives, both from event broadcasts and from
+// the replies to getters. Attach one with Linkbot::addStateObserver(). The
+// member functions are called on the Linkbot's I/O thread, so they must be
+// quick and must not call back into the Linkbot, except for toHostTime(),
+// which only reads the clock estimate. timestamp is the robot's
+// clock (0 if the robot did not supply one); hostTime is in microseconds on
+// the host's steady clock, as in RobotState, and is when the message arrived.
+// Linkbot::toHostTime(timestamp) says when the robot sampled it; the
+// difference is the delivery latency.
+class StateObserver {
+public:
+    virtual ~StateObserver () {}
+    virtual void onJointAngle (int joint, double degrees, int timestamp, int64_t hostTime) {}
+    virtual void onJointState (int joint, JointState::Type state, int timestamp, int64_t hostTime) {}
+    virtual void onAccelerometer (double x, double y, double z, int timestamp, int64_t hostTime) {}
+    virtual void onBatteryVoltage (double volts, int64_t hostTime) {}
+};
+
 /* A C++03-compatible Linkbot API. */
 class Linkbot {
 public:
@@ -19,8 +64,25 @@ public:
 
     // Ask the daemon to resolve the given serial ID to a WebSocket host:service,
     // and construct a Linkbot backed by this WebSocket endpoint.
+    //
+    // "broker:ABCD" instead connects through a baromesh-broker running for
+    // robot ABCD on this host, so that several processes can drive the same
+    // robot over one connection.
+    //
+    // "unix:/path" connects to a robot proxy listening on a Unix-domain
+    // socket, and "inproc://name" to a robot implementation served in this
+    // process. The daemon itself is found at 127.0.0.1:42000 unless the
+    // BAROMESH_DAEMON_ENDPOINT environment variable names another
+    // "host:service" or "unix:/path".
     explicit Linkbot (const std::string& serialId);
 
+    // Linkbots in the same process which name the same robot, by the same
+    // host:service or serial ID, share one connection and one set of event
+    // subscriptions. Each handle keeps its own callbacks, and every event is
+    // delivered to all of them. Write coalescing, shadow state and state
+    // observers belong to the shared connection. The connection closes with
+    // the last handle.
+
     ~Linkbot ();
 
 private:
@@ -30,66 +92,136 @@ private:
 
 public:
     // All member functions may throw a barobo::Error exception on failure.
+    // Every member function also has an overload taking a trailing
+    // boost::system::error_code& which reports failure through that argument
+    // instead and never throws. Prefer these in retry loops: a timeout then
+    // costs no allocation, no stack unwinding, and no I/O.
 
     /* GETTERS */
     // Member functions take angles in degrees.
     // All functions are non-blocking. Use moveWait() to wait for non-blocking
     // movement functions.
+    // A timestamp argument is in milliseconds on the robot's clock, and 0 means
+    // unknown (see CLOCK SYNCHRONIZATION). toHostTime() converts it to host
+    // time; getRobotState() and StateObserver report host times directly.
     void getAccelerometer (int& timestamp, double&, double&, double&);
+    void getAccelerometer (int& timestamp, double&, double&, double&,
+                           boost::system::error_code&) BOOST_NOEXCEPT;
     std::vector<int> getAdcRaw();
+    std::vector<int> getAdcRaw(boost::system::error_code&) BOOST_NOEXCEPT;
     void getBatteryVoltage(double& voltage);
+    void getBatteryVoltage(double& voltage, boost::system::error_code&) BOOST_NOEXCEPT;
+    // getFormFactor(), getVersions() and getSerialId() are fetched together
+    // when the connection opens and answered from memory afterward. They ask
+    // the robot only if that failed, or after the connection terminated, or,
+    // for the serial ID, after writeEeprom() touched it.
     void getFormFactor(FormFactor::Type & form);
+    void getFormFactor(FormFactor::Type & form, boost::system::error_code&) BOOST_NOEXCEPT;
     void getJointAngles (int& timestamp, double&, double&, double&);
+    void getJointAngles (int& timestamp, double&, double&, double&,
+                         boost::system::error_code&) BOOST_NOEXCEPT;
     void getJointSpeeds(double&, double&, double&);
+    void getJointSpeeds(double&, double&, double&, boost::system::error_code&) BOOST_NOEXCEPT;
     void getJointStates(int& timestamp,
                         JointState::Type & s1,
                         JointState::Type & s2,
                         JointState::Type & s3);
+    void getJointStates(int& timestamp,
+                        JointState::Type & s1,
+                        JointState::Type & s2,
+                        JointState::Type & s3,
+                        boost::system::error_code&) BOOST_NOEXCEPT;
     void getLedColor (int&, int&, int&);
+    void getLedColor (int&, int&, int&, boost::system::error_code&) BOOST_NOEXCEPT;
     void getVersions (uint32_t&, uint32_t&, uint32_t&);
+    void getVersions (uint32_t&, uint32_t&, uint32_t&, boost::system::error_code&) BOOST_NOEXCEPT;
     void getSerialId(std::string& serialId);
+    void getSerialId(std::string& serialId, boost::system::error_code&) BOOST_NOEXCEPT;
     void getJointSafetyThresholds(int&, int&, int&);
+    void getJointSafetyThresholds(int&, int&, int&, boost::system::error_code&) BOOST_NOEXCEPT;
     void getJointSafetyAngles(double&, double&, double&);
+    void getJointSafetyAngles(double&, double&, double&, boost::system::error_code&) BOOST_NOEXCEPT;
+    // Read joint angles, speeds and states, the accelerometer, the battery
+    // voltage and the LED color all at once. The six requests are pipelined,
+    // so this costs about one round trip instead of six.
+    void getRobotState(RobotState& state);
+    void getRobotState(RobotState& state, boost::system::error_code&) BOOST_NOEXCEPT;
 
     /* SETTERS */
     void resetEncoderRevs();
+    void resetEncoderRevs(boost::system::error_code&) BOOST_NOEXCEPT;
     void setBuzzerFrequency (double);
+    void setBuzzerFrequency (double, boost::system::error_code&) BOOST_NOEXCEPT;
     void setJointAccelI(int mask, double, double, double);
+    void setJointAccelI(int mask, double, double, double, boost::system::error_code&) BOOST_NOEXCEPT;
     void setJointAccelF(int mask, double, double, double);
+    void setJointAccelF(int mask, double, double, double, boost::system::error_code&) BOOST_NOEXCEPT;
     void setJointSpeeds (int mask, double, double, double);
+    void setJointSpeeds (int mask, double, double, double, boost::system::error_code&) BOOST_NOEXCEPT;
     void setJointStates(
         int mask,
         JointState::Type s1, double d1,
         JointState::Type s2, double d2,
         JointState::Type s3, double d3);
+    void setJointStates(
+        int mask,
+        JointState::Type s1, double d1,
+        JointState::Type s2, double d2,
+        JointState::Type s3, double d3,
+        boost::system::error_code&) BOOST_NOEXCEPT;
     void setJointStates(
         int mask,
         JointState::Type s1, double d1, double timeout1, JointState::Type end1,
         JointState::Type s2, double d2, double timeout2, JointState::Type end2,
         JointState::Type s3, double d3, double timeout3, JointState::Type end3
         );
+    void setJointStates(
+        int mask,
+        JointState::Type s1, double d1, double timeout1, JointState::Type end1,
+        JointState::Type s2, double d2, double timeout2, JointState::Type end2,
+        JointState::Type s3, double d3, double timeout3, JointState::Type end3,
+        boost::system::error_code&) BOOST_NOEXCEPT;
     void setLedColor (int, int, int);
+    void setLedColor (int, int, int, boost::system::error_code&) BOOST_NOEXCEPT;
     void setJointSafetyThresholds(int mask, int t1=100, int t2=100, int t3=100);
+    void setJointSafetyThresholds(int mask, int t1, int t2, int t3,
+                                  boost::system::error_code&) BOOST_NOEXCEPT;
     void setJointSafetyAngles(int mask, double t1=10, double t2=10, double t3=10);
+    void setJointSafetyAngles(int mask, double t1, double t2, double t3,
+                              boost::system::error_code&) BOOST_NOEXCEPT;
 
     /* MOVEMENT */
     // Member functions take angles in degrees.
     // All functions are non-blocking. Use moveWait() to wait for non-blocking
     // movement functions.
     void drive (int mask, double, double, double);
+    void drive (int mask, double, double, double, boost::system::error_code&) BOOST_NOEXCEPT;
     void driveTo (int mask, double, double, double);
+    void driveTo (int mask, double, double, double, boost::system::error_code&) BOOST_NOEXCEPT;
     void move (int mask, double, double, double);
+    void move (int mask, double, double, double, boost::system::error_code&) BOOST_NOEXCEPT;
     // moveContinuous takes three angular speed coefficients. Use -1 to move
     // a motor backward, +1 to move it forward.
     void moveAccel(int mask, int relativeMask,
         double omega0_i, double timeout0, JointState::Type endstate0,
         double omega1_i, double timeout1, JointState::Type endstate1,
         double omega2_i, double timeout2, JointState::Type endstate2);
+    void moveAccel(int mask, int relativeMask,
+        double omega0_i, double timeout0, JointState::Type endstate0,
+        double omega1_i, double timeout1, JointState::Type endstate1,
+        double omega2_i, double timeout2, JointState::Type endstate2,
+        boost::system::error_code&) BOOST_NOEXCEPT;
     void moveContinuous (int mask, double, double, double);
+    void moveContinuous (int mask, double, double, double, boost::system::error_code&) BOOST_NOEXCEPT;
     void moveTo (int mask, double, double, double);
+    void moveTo (int mask, double, double, double, boost::system::error_code&) BOOST_NOEXCEPT;
     void moveSmooth(int mask, int relativeMask, double a0, double a1, double a2);
+    void moveSmooth(int mask, int relativeMask, double a0, double a1, double a2,
+                    boost::system::error_code&) BOOST_NOEXCEPT;
     void motorPower(int mask, int m1, int m2, int m3);
+    void motorPower(int mask, int m1, int m2, int m3, boost::system::error_code&) BOOST_NOEXCEPT;
     void stop (int mask = 0x07);
+    void stop (int mask, boost::system::error_code&) BOOST_NOEXCEPT;
 
     /* CALLBACKS */
     typedef void (*ButtonEventCallback)(Button::Type button, ButtonState::Type event, int timestamp, void* userData);
@@ -102,22 +234,161 @@ public:
     // Passing a null pointer as the first parameter of those three functions
     // will disable its respective events.
     void setButtonEventCallback (ButtonEventCallback, void* userData);
+    void setButtonEventCallback (ButtonEventCallback, void* userData,
+                                 boost::system::error_code&) BOOST_NOEXCEPT;
     void setEncoderEventCallback (EncoderEventCallback, double granularity, void* userData);
+    void setEncoderEventCallback (EncoderEventCallback, double granularity, void* userData,
+                                  boost::system::error_code&) BOOST_NOEXCEPT;
     void setJointEventCallback (JointEventCallback, void* userData);
+    void setJointEventCallback (JointEventCallback, void* userData,
+                                boost::system::error_code&) BOOST_NOEXCEPT;
     void setAccelerometerEventCallback (AccelerometerEventCallback, void* userData);
+    void setAccelerometerEventCallback (AccelerometerEventCallback, void* userData,
+                                        boost::system::error_code&) BOOST_NOEXCEPT;
     void setConnectionTerminatedCallback (ConnectionTerminatedCallback, void* userData);
+    void setConnectionTerminatedCallback (ConnectionTerminatedCallback, void* userData,
+                                          boost::system::error_code&) BOOST_NOEXCEPT;
+
+    /* STATE OBSERVERS */
+    // While at least one observer is attached, the robot's encoder events
+    // (at the finest granularity requested, in degrees), joint events and
+    // accelerometer events stay enabled even if no callback wants them. An
+    // observer must stay alive until it is removed.
+    void addStateObserver (StateObserver*, double encoderGranularity = 1.0);
+    void addStateObserver (StateObserver*, double encoderGranularity,
+                           boost::system::error_code&) BOOST_NOEXCEPT;
+    void removeStateObserver (StateObserver*);
+    void removeStateObserver (StateObserver*, boost::system::error_code&) BOOST_NOEXCEPT;
+
+    /* CLOCK SYNCHRONIZATION */
+    // The Linkbot estimates the offset and drift between the robot's clock,
+    // which stamps events and getJointAngles in milliseconds, and the host's
+    // steady clock. Every getJointAngles round trip refines the estimate;
+    // synchronizeClock() makes rounds dedicated ones. The robot does not stamp
+    // getAccelerometer and getJointStates replies, so those report the robot
+    // time at which their request was most likely served: the estimate's
+    // robot time at the midpoint of the request's round trip, even if the
+    // call only waited for another caller's identical request. Until there
+    // is an estimate, their timestamp is 0, meaning unknown.
+    void synchronizeClock (int rounds = 8);
+    void synchronizeClock (int rounds, boost::system::error_code&) BOOST_NOEXCEPT;
+    // Host steady-clock time, in microseconds as in RobotState, at which the
+    // robot's clock read timestamp. 0 if there is no estimate yet.
+    int64_t toHostTime (int timestamp) const;
+    // The current estimate's drift of the robot's clock relative to the
+    // host's, in parts per million, and its uncertainty: half the quickest
+    // round trip sampled, in microseconds. False if there is no estimate yet.
+    bool getClockSync (double& driftPpm, double& uncertaintyMicroseconds) const;
 
     /* MISC */
     void writeEeprom(uint32_t address, const uint8_t *data, size_t size);
+    void writeEeprom(uint32_t address, const uint8_t *data, size_t size,
+                     boost::system::error_code&) BOOST_NOEXCEPT;
     void readEeprom(uint32_t address, size_t recvsize, uint8_t *buffer);
+    void readEeprom(uint32_t address, size_t recvsize, uint8_t *buffer,
+                    boost::system::error_code&) BOOST_NOEXCEPT;
     void writeTwi(uint32_t address, const uint8_t *data, size_t size);
+    void writeTwi(uint32_t address, const uint8_t *data, size_t size,
+                  boost::system::error_code&) BOOST_NOEXCEPT;
     void readTwi(uint32_t address, size_t recvsize, uint8_t *buffer);
+    void readTwi(uint32_t address, size_t recvsize, uint8_t *buffer,
+                 boost::system::error_code&) BOOST_NOEXCEPT;
     void writeReadTwi(
         uint32_t address,
         const uint8_t *sendbuf,
         size_t sendsize,
         uint8_t* recvbuf,
         size_t recvsize);
+    void writeReadTwi(
+        uint32_t address,
+        const uint8_t *sendbuf,
+        size_t sendsize,
+        uint8_t* recvbuf,
+        size_t recvsize,
+        boost::system::error_code&) BOOST_NOEXCEPT;
+
+    /* WRITE COALESCING */
+    // In write-coalescing mode, setLedColor, setBuzzerFrequency,
+    // setJointSpeeds and motorPower return without waiting for the robot.
+    // Each of these setters keeps at most one request in flight. Values set
+    // while it is outstanding replace each other (joint by joint, for the
+    // masked setters), and only the newest is sent once the robot acknowledges
+    // the previous request. A failed request is reported by the next call to
+    // the same setter, unless it was cancelled by a stop, which is not a
+    // failure of the setter. Turning the mode off waits for outstanding
+    // writes.
+    void setWriteCoalescing (bool enable);
+
+    /* SHADOW STATE */
+    // The Linkbot remembers the last values of setJointSpeeds,
+    // setJointSafetyThresholds, setJointSafetyAngles and setLedColor which the
+    // robot acknowledged. With shadow state enabled, these setters return
+    // immediately without contacting the robot if the new value would not
+    // change anything. The shadow copy is discarded on any error and when the
+    // connection terminates.
+    void setShadowState (bool enable);
+
+    /* STATISTICS */
+    // getAccelerometer, getBatteryVoltage, getJointAngles and getJointStates
+    // are single-flight: a call made while an identical request is already
+    // outstanding waits for that request's reply instead of sending its own.
+    // sent counts the requests actually sent, saved counts the ones avoided.
+    void getCoalescingStats (uint64_t& sent, uint64_t& saved) const;
+
+    /* FLOW CONTROL */
+    // Every request on a connection, from any thread or handle, passes
+    // through a window of outstanding requests. The window grows by about one
+    // request per round trip while round trips stay near the quickest seen
+    // recently, and halves on a timeout or when round trips inflate, so a
+    // flood of pipelined requests cannot swamp a slow radio link. Requests
+    // beyond the window wait their turn in order. setFlowControlLimit() caps
+    // the window (32 by default; 1 serializes all requests).
+    void setFlowControlLimit (unsigned maxInFlight);
+    // The current window, the requests in flight and waiting behind it, and
+    // the smoothed round trip in microseconds.
+    void getFlowControlStats (double& window, unsigned& inFlight, unsigned& queued,
+                              double& roundTripMicroseconds) const;
+
+    /* PRIORITY */
+    // stop(), motorPower() with every masked joint at 0, setJointSafetyThresholds
+    // and setJointSafetyAngles bypass write coalescing and the flow-control
+    // window: they are handed to the connection on the calling thread, ahead
+    // of anything queued. stop() and motorPower(0) also abandon motion
+    // commands still queued behind the window, which then fail, and drop the
+    // stopped joints from any coalesced motorPower write not yet sent.
+    // The time from the call to the handoff is measured; this reports the
+    // latest and the largest, in microseconds.
+    void getPriorityDispatchLatency (double& lastMicroseconds, double& maxMicroseconds) const;
+
+    /* TRACING */
+    // Record, for every blocking call in the process, when it was made, when
+    // the request was queued, how long the transport spent writing it, when
+    // the reply was decoded and when the caller woke; and for every event
+    // broadcast, when it was received and how long the callbacks took.
+    // Tracing costs nothing measurable while off. stopTrace() writes what was
+    // recorded, at most capacity spans, to path as Chrome trace-event JSON
+    // for chrome://tracing or Perfetto.
+    static void startTrace (size_t capacity = 1 << 20);
+    static void stopTrace (const std::string& path);
+
+    /* I/O THREADS */
+    // By default, all Linkbots in a process share a single I/O thread, which
+    // also runs every callback. setIoThreadPool() replaces it with a pool of
+    // threadCount threads; each Linkbot constructed afterwards is assigned to
+    // the least-loaded one and stays there for its lifetime. If pinThreads is
+    // true, I/O thread i is pinned to CPU i (modulo the CPU count); with a
+    // threadCount of 1, that is a dedicated thread pinned to CPU 0.
+    //
+    // If busyPoll is true, each I/O thread spins on the event loop instead of
+    // sleeping, and blocking member functions spin briefly waiting for their
+    // reply before they park. This costs one CPU per I/O thread and buys lower
+    // and tighter round-trip latency; combine it with pinThreads.
+    static void setIoThreadPool (unsigned threadCount, bool pinThreads = false,
+                                 bool busyPoll = false);
+    // Number of Linkbots assigned to each I/O thread, indexed by shard.
+    static std::vector<unsigned> ioShardLoads ();
+    // The I/O thread this Linkbot is assigned to.
+    unsigned ioShard () const;
 
 private:
     struct Impl;
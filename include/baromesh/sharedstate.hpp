@@ -0,0 +1,87 @@
+#ifndef BAROMESH_SHAREDSTATE_HPP
+#define BAROMESH_SHAREDSTATE_HPP
+
+#include <baromesh/linkbot.hpp>
+
+#include <string>
+
+#include <stdint.h>
+
+namespace barobo {
+
+// One robot's live state as published in shared memory. Each quantity carries
+// the robot timestamp and host time (see StateObserver) of its last update.
+struct SharedRobotState {
+    double jointAngles[3];
+    int jointAnglesTimestamp[3];
+    int64_t jointAnglesHostTime[3];
+
+    JointState::Type jointStates[3];
+    int64_t jointStatesHostTime[3];
+
+    double accelerometer[3];
+    int accelerometerTimestamp;
+    int64_t accelerometerHostTime;
+
+    double batteryVoltage;
+    int64_t batteryVoltageHostTime;
+};
+
+/* Publishes a robot's state into a POSIX shared-memory region, so that other
+ * processes on the same host can read it with a SharedStateReader without
+ * touching the robot link.
+ *
+ * The region is named "/baromesh-<name>", typically the robot's serial ID. It
+ * is created on construction and unlinked on destruction. Updates come from a
+ * StateObserver attached to the Linkbot, and are guarded by a sequence lock:
+ * the writer never waits, readers retry if they race with an update.
+ *
+ * Only available on POSIX hosts; elsewhere the constructor throws. */
+class SharedStateExporter {
+public:
+    // Throws barobo::Error if the region cannot be created, including when
+    // another live exporter holds the name, or if the robot's events cannot
+    // be enabled. A region left behind by an exporter which died is replaced.
+    // The Linkbot must outlive the exporter.
+    SharedStateExporter (Linkbot& linkbot, const std::string& name,
+                         double encoderGranularity = 1.0);
+    ~SharedStateExporter ();
+
+private:
+    // noncopyable
+    SharedStateExporter (const SharedStateExporter&);
+    SharedStateExporter& operator= (const SharedStateExporter&);
+
+    struct Impl;
+    Impl* m;
+};
+
+/* Maps a region published by a SharedStateExporter, possibly in another
+ * process, and reads consistent snapshots from it. */
+class SharedStateReader {
+public:
+    // Throws barobo::Error if no exporter has published the region.
+    explicit SharedStateReader (const std::string& name);
+    ~SharedStateReader ();
+
+private:
+    // noncopyable
+    SharedStateReader (const SharedStateReader&);
+    SharedStateReader& operator= (const SharedStateReader&);
+
+public:
+    // Copy out a consistent snapshot. Costs a few cache-line reads; retries
+    // only if an update is in progress.
+    void read (SharedRobotState& state) const;
+
+    // Number of updates published so far. Cheap way to poll for changes.
+    uint64_t version () const;
+
+private:
+    struct Impl;
+    Impl* m;
+};
+
+} // namespace barobo
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef BAROMESH_SIMULATOR_HPP
+#define BAROMESH_SIMULATOR_HPP
+
+#include <baromesh/linkbot.h>
+
+#include <string>
+
+namespace barobo {
+
+/* A simulated Linkbot serving the robot RPC interface, for tests, benchmarks
+ * and load tests without hardware.
+ *
+ * Joints follow a kinematic model: move, moveTo, drive, driveTo, moveSmooth,
+ * moveContinuous, moveAccel, motorPower, setJointSpeeds and stop behave as on
+ * a robot, and the joints report encoder events at the granularity requested
+ * and joint events on every state change. The accelerometer reads 1 g
+ * straight down, the battery is always full, and the buttons never change.
+ * Requests the simulator does not model succeed and do nothing.
+ *
+ * The simulator runs on an I/O thread from the same pool as Linkbots, so
+ * hundreds of them fit in one process. Connect to one with
+ * Linkbot{endpoint}. */
+class Simulator {
+public:
+    // Serve at endpoint, "inproc://name" or "unix:/path". serialId is what
+    // Linkbot::getSerialId() will report. Throws barobo::Error if the
+    // endpoint cannot be bound.
+    explicit Simulator (const std::string& endpoint,
+                        const std::string& serialId = "SIM0",
+                        FormFactor::Type formFactor = FormFactor::I);
+
+    // Disconnects every client.
+    ~Simulator ();
+
+private:
+    // noncopyable
+    Simulator (const Simulator&);
+    Simulator& operator= (const Simulator&);
+
+public:
+    const std::string& endpoint () const;
+
+private:
+    struct Impl;
+    Impl* m;
+};
+
+} // namespace barobo
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef BAROMESH_ANGLEHISTORY_HPP
+#define BAROMESH_ANGLEHISTORY_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <cstddef>
+
+namespace baromesh {
+
+// A fixed-capacity ring of one joint's angle samples, indexed by robot
+// timestamp (milliseconds). When full, the oldest sample is overwritten.
+class AngleHistory {
+public:
+    // A sample this much older than the newest means the robot restarted its
+    // clock; anything closer is a late delivery.
+    static const int kClockResetMs = 1000;
+
+    struct Sample {
+        int timestamp;
+        double degrees;
+    };
+
+    explicit AngleHistory (size_t capacity)
+        : mSamples(std::max(capacity, size_t(2)))
+    {}
+
+    size_t size () const { return mSize; }
+    size_t capacity () const { return mSamples.size(); }
+
+    void clear () { mSize = 0; }
+
+    // Sample i, counting from the oldest.
+    const Sample& at (size_t i) const {
+        return mSamples[(mHead + mSamples.size() - mSize + i) % mSamples.size()];
+    }
+
+    const Sample& newest () const { return at(mSize - 1); }
+
+    // Record a sample. A sample at an existing sample's timestamp replaces
+    // it. Events can arrive out of order, so a sample older than the newest is
+    // put in its place, or dropped if it is older than everything a full
+    // history keeps. Only a sample more than kClockResetMs older than the
+    // newest, i.e., after the robot restarted its clock, starts the history
+    // over.
+    void push (int timestamp, double degrees) {
+        if (mSize && timestamp <= newest().timestamp) {
+            if (newest().timestamp - timestamp > kClockResetMs) {
+                clear();
+            }
+            else {
+                insert(timestamp, degrees);
+                return;
+            }
+        }
+        mSamples[mHead] = Sample{timestamp, degrees};
+        mHead = (mHead + 1) % mSamples.size();
+        mSize = std::min(mSize + 1, mSamples.size());
+    }
+
+    // The angle at timestamp, interpolated linearly between the samples on
+    // either side. False if timestamp is outside the recorded history.
+    // O(log size).
+    bool angleAt (int timestamp, double& degrees) const {
+        if (!mSize || timestamp < at(0).timestamp || timestamp > newest().timestamp) {
+            return false;
+        }
+        auto lo = lowerBound(timestamp);
+        auto& b = at(lo);
+        if (b.timestamp == timestamp) {
+            degrees = b.degrees;
+            return true;
+        }
+        auto& a = at(lo - 1);
+        auto f = double(timestamp - a.timestamp) / (b.timestamp - a.timestamp);
+        degrees = a.degrees + f * (b.degrees - a.degrees);
+        return true;
+    }
+
+    // Least-squares slope, in degrees per second, of the samples no more than
+    // windowMs older than the newest, and always of at least the newest two.
+    // False with fewer than two samples.
+    bool velocity (int windowMs, double& degreesPerSecond) const {
+        if (mSize < 2) {
+            return false;
+        }
+        auto t0 = newest().timestamp;
+        size_t n = 0;
+        double st = 0, sa = 0, stt = 0, sta = 0;
+        for (auto i = mSize; i-- > 0;) {
+            auto& s = at(i);
+            if (n >= 2 && t0 - s.timestamp > windowMs) {
+                break;
+            }
+            double t = s.timestamp - t0;
+            st += t;
+            sa += s.degrees;
+            stt += t * t;
+            sta += t * s.degrees;
+            ++n;
+        }
+        auto d = n * stt - st * st;
+        if (d <= 0) {
+            return false;
+        }
+        degreesPerSecond = 1000 * (n * sta - st * sa) / d;
+        return true;
+    }
+
+private:
+    Sample& slot (size_t i) {
+        return mSamples[(mHead + mSamples.size() - mSize + i) % mSamples.size()];
+    }
+
+    // Binary search for the first sample at or after timestamp; size() if
+    // there is none.
+    size_t lowerBound (int timestamp) const {
+        size_t lo = 0, hi = mSize;
+        while (lo < hi) {
+            auto mid = lo + (hi - lo) / 2;
+            if (at(mid).timestamp < timestamp) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // Put a sample no newer than the newest in timestamp order. O(size).
+    void insert (int timestamp, double degrees) {
+        auto i = lowerBound(timestamp);
+        if (at(i).timestamp == timestamp) {
+            slot(i).degrees = degrees;
+            return;
+        }
+        auto full = mSize == mSamples.size();
+        if (full && !i) {
+            return;
+        }
+        // Grow by one at the newest end, losing the oldest if full, then move
+        // the samples after the new one's place up by one.
+        mHead = (mHead + 1) % mSamples.size();
+        if (full) {
+            --i;
+        }
+        else {
+            ++mSize;
+        }
+        for (auto j = mSize - 1; j > i; --j) {
+            slot(j) = slot(j - 1);
+        }
+        slot(i) = Sample{timestamp, degrees};
+    }
+
+    std::vector<Sample> mSamples;
+    size_t mHead = 0;  // where the next sample goes
+    size_t mSize = 0;
+};
+
+} // namespace baromesh
+
+#endif
@@ -0,0 +1,499 @@
+// baromesh-broker: own one robot's connection and share it with every
+// process on this host.
+//
+//     baromesh-broker SERIAL_ID
+//
+// Clients connect with barobo::Linkbot{"broker:SERIAL_ID"}. Requests from all
+// clients are multiplexed onto the one robot session, each client's replies
+// are routed back to it, and broadcasts are fanned out to the clients which
+// subscribed to them. Event subscriptions sent to the robot are the union of
+// the clients' subscriptions.
+
+#include "daemon.hpp"
+#include "endpoint.hpp"
+#include "iopool.hpp"
+#include "messagequeue.hpp"
+#include "websocketclient.hpp"
+
+#include "gen-robot.pb.hpp"
+
+#include <baromesh/error.hpp>
+#include <baromesh/log.hpp>
+#include <baromesh/websocketconnector.hpp>
+
+#include <rpc/asio/server.hpp>
+
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/use_future.hpp>
+
+#include <boost/log/sources/logger.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+using MethodIn = rpc::MethodIn<barobo::Robot>;
+using Broadcast = rpc::Broadcast<barobo::Robot>;
+using LocalServer = rpc::asio::Server<baromesh::LocalMessageQueue>;
+using rpc::asio::asyncFire;
+
+using boost::asio::use_future;
+
+std::chrono::milliseconds requestTimeout () {
+    return std::chrono::milliseconds{1000};
+}
+
+class Broker;
+
+// One connected client process.
+struct Session : std::enable_shared_from_this<Session> {
+    Session (std::shared_ptr<Broker> b, boost::asio::io_service& ios)
+        : broker(std::move(b)), server(ios) {}
+
+    // Forward a request upstream as soon as it arrives, and route the reply
+    // back to this client. Any number may be in flight.
+    template <class In, class Result = typename rpc::ResultOf<In>::type>
+    void onFire (const In& args, rpc::asio::RequestId requestId);
+
+    // Event subscriptions are per client; the robot gets the union.
+    void onFire (const MethodIn::enableButtonEvent& args, rpc::asio::RequestId requestId);
+    void onFire (const MethodIn::enableEncoderEvent& args, rpc::asio::RequestId requestId);
+    void onFire (const MethodIn::enableJointEvent& args, rpc::asio::RequestId requestId);
+    void onFire (const MethodIn::enableAccelerometerEvent& args, rpc::asio::RequestId requestId);
+
+    template <class Result>
+    void reply (rpc::asio::RequestId requestId, const Result& result) {
+        auto self = shared_from_this();
+        rpc::asio::asyncReply(server, requestId, result,
+            [self] (boost::system::error_code ec) {
+                if (ec) {
+                    BOOST_LOG(self->log) << "Error replying to client: " << ec.message();
+                }
+            });
+    }
+
+    // Report a request which failed upstream to the client, rather than let
+    // the client's request time out.
+    void fail (rpc::asio::RequestId requestId, boost::system::error_code ec) {
+        auto self = shared_from_this();
+        rpc::asio::asyncReplyStatus(server, requestId, ec,
+            [self] (boost::system::error_code ec) {
+                if (ec) {
+                    BOOST_LOG(self->log) << "Error replying to client: " << ec.message();
+                }
+            });
+    }
+
+    template <class B>
+    void broadcast (const B& b) {
+        auto self = shared_from_this();
+        rpc::asio::asyncBroadcast(server, b,
+            [self] (boost::system::error_code ec) {
+                if (ec) {
+                    BOOST_LOG(self->log) << "Error broadcasting to client: " << ec.message();
+                }
+            });
+    }
+
+    bool encoderEnabled (int encoder) const {
+        switch (encoder) {
+            case 0: return encoderEvents.has_encoderOne && encoderEvents.encoderOne.enable;
+            case 1: return encoderEvents.has_encoderTwo && encoderEvents.encoderTwo.enable;
+            case 2: return encoderEvents.has_encoderThree && encoderEvents.encoderThree.enable;
+            default: return false;
+        }
+    }
+
+    bool anyEncoderEnabled () const {
+        return encoderEnabled(0) || encoderEnabled(1) || encoderEnabled(2);
+    }
+
+    mutable boost::log::sources::logger log;
+    std::shared_ptr<Broker> broker;
+    LocalServer server;
+
+    MethodIn::enableButtonEvent buttonEvents = {};
+    MethodIn::enableEncoderEvent encoderEvents = {};
+    MethodIn::enableJointEvent jointEvents = {};
+    MethodIn::enableAccelerometerEvent accelerometerEvents = {};
+};
+
+// Owns the upstream robot client and the listening socket. Everything but
+// construction and disconnect() runs on the one I/O thread, so nothing here
+// needs a lock.
+class Broker : public std::enable_shared_from_this<Broker> {
+public:
+    Broker (boost::asio::io_service& ios, const std::string& serialId)
+        : mIos(ios)
+        , mConnector(ios)
+        , mRobot(ios)
+        , mAcceptor(ios)
+        , mPath(baromesh::brokerSocketPath(serialId))
+    {
+        auto endpoint = baromesh::robotEndpoint(
+            baromesh::resolveSerialId(ios, serialId, requestTimeout()));
+
+        BOOST_LOG(mLog) << "Connecting to Linkbot proxy at " << endpoint;
+        baromesh::connectEndpoint(mRobot.messageQueue(), mConnector, endpoint);
+        rpc::asio::asyncConnect<barobo::Robot>(mRobot, requestTimeout(), use_future).get();
+
+        prepareSocketPath();
+        boost::asio::local::stream_protocol::endpoint local{mPath};
+        mAcceptor.open(local.protocol());
+        mAcceptor.bind(local);
+        mAcceptor.listen();
+        BOOST_LOG(mLog) << "Listening on " << mPath;
+    }
+
+    // Start serving. done is called once, on the I/O thread, after stop() or
+    // when the robot's connection ends.
+    void start (std::function<void()> done) {
+        mDone = std::move(done);
+        auto self = shared_from_this();
+        mIos.post([self] {
+            rpc::asio::asyncRunClient<barobo::Robot>(self->mRobot, *self,
+                [self] (boost::system::error_code ec) {
+                    BOOST_LOG(self->mLog) << "Robot connection ended: " << ec.message();
+                    self->stop();
+                });
+            self->accept();
+        });
+    }
+
+    // Stop accepting and drop every client. Call on the I/O thread.
+    void stop () {
+        if (!mDone) {
+            return;
+        }
+        auto ec = boost::system::error_code{};
+        mAcceptor.close(ec);
+        std::remove(mPath.c_str());
+        for (auto& session : mSessions) {
+            session->server.close();
+        }
+        mSessions.clear();
+        auto done = std::move(mDone);
+        mDone = nullptr;
+        done();
+    }
+
+    // Blocking; call from any thread but the I/O thread, after stop().
+    void disconnect () {
+        try {
+            BOOST_LOG(mLog) << "Disconnecting robot client";
+            asyncDisconnect(mRobot, requestTimeout(), use_future).get();
+        }
+        catch (std::exception& e) {
+            BOOST_LOG(mLog) << "Exception during disconnect: " << e.what();
+        }
+        mRobot.close();
+    }
+
+    template <class In, class Handler>
+    void fire (const In& args, Handler&& handler) {
+        asyncFire(mRobot, args, requestTimeout(), std::forward<Handler>(handler));
+    }
+
+    // Overwrite args with the union of every client's subscription of its
+    // kind.
+    void subscriptions (MethodIn::enableButtonEvent& args) const {
+        args = {};
+        for (auto& s : mSessions) {
+            args.enable = args.enable || s->buttonEvents.enable;
+        }
+    }
+
+    void subscriptions (MethodIn::enableEncoderEvent& args) const {
+        using Granularity = decltype(args.encoderOne);
+        auto merge = [] (Granularity& to, bool has, const Granularity& from) {
+            if (has && from.enable) {
+                to.granularity = to.enable ? std::min(to.granularity, from.granularity)
+                                           : from.granularity;
+                to.enable = true;
+            }
+        };
+        args = {};
+        for (auto& s : mSessions) {
+            auto& e = s->encoderEvents;
+            merge(args.encoderOne, e.has_encoderOne, e.encoderOne);
+            merge(args.encoderTwo, e.has_encoderTwo, e.encoderTwo);
+            merge(args.encoderThree, e.has_encoderThree, e.encoderThree);
+        }
+        // Explicitly disable what nobody wants any more.
+        args.has_encoderOne = args.has_encoderTwo = args.has_encoderThree = true;
+    }
+
+    void subscriptions (MethodIn::enableJointEvent& args) const {
+        args = {};
+        for (auto& s : mSessions) {
+            args.enable = args.enable || s->jointEvents.enable;
+        }
+    }
+
+    void subscriptions (MethodIn::enableAccelerometerEvent& args) const {
+        args = {};
+        for (auto& s : mSessions) {
+            auto& e = s->accelerometerEvents;
+            if (e.enable) {
+                args.granularity = args.enable ? std::min(args.granularity, e.granularity)
+                                               : e.granularity;
+                args.enable = true;
+            }
+        }
+    }
+
+    // Send the current union of subscriptions of kind In to the robot.
+    template <class In, class Handler>
+    void resubscribe (Handler&& handler) {
+        auto args = In{};
+        subscriptions(args);
+        fire(args, std::forward<Handler>(handler));
+    }
+
+    // Broadcasts from the robot go to each client subscribed to them.
+    void onBroadcast (const Broadcast::buttonEvent& b) {
+        fanOut(b, [] (const Session& s) { return s.buttonEvents.enable; });
+    }
+
+    void onBroadcast (const Broadcast::encoderEvent& b) {
+        fanOut(b, [&b] (const Session& s) { return s.encoderEnabled(b.encoder); });
+    }
+
+    void onBroadcast (const Broadcast::jointEvent& b) {
+        fanOut(b, [] (const Session& s) { return s.jointEvents.enable; });
+    }
+
+    void onBroadcast (const Broadcast::accelerometerEvent& b) {
+        fanOut(b, [] (const Session& s) { return s.accelerometerEvents.enable; });
+    }
+
+    template <class B>
+    void onBroadcast (const B& b) {
+        fanOut(b, [] (const Session&) { return true; });
+    }
+
+private:
+    template <class B, class Pred>
+    void fanOut (const B& b, Pred&& subscribed) {
+        for (auto& s : mSessions) {
+            if (subscribed(*s)) {
+                s->broadcast(b);
+            }
+        }
+    }
+
+    // Create the socket directory if need be and make sure it is ours alone,
+    // then remove a socket left behind by an earlier broker. Anything at the
+    // path which is not our own socket is left alone, and we refuse to start.
+    void prepareSocketPath () {
+        auto directory = baromesh::brokerSocketDirectory();
+        if (-1 == mkdir(directory.c_str(), 0700) && EEXIST != errno) {
+            throw barobo::Error("mkdir " + directory + ": " + strerror(errno));
+        }
+        if (!baromesh::isPrivateDirectory(directory)) {
+            throw barobo::Error(directory + " is not a private directory of this user");
+        }
+        struct stat st;
+        if (-1 == lstat(mPath.c_str(), &st)) {
+            if (ENOENT != errno) {
+                throw barobo::Error("lstat " + mPath + ": " + strerror(errno));
+            }
+            return;
+        }
+        if (!S_ISSOCK(st.st_mode) || st.st_uid != getuid()) {
+            throw barobo::Error(mPath + " exists and is not our socket");
+        }
+        if (-1 == unlink(mPath.c_str())) {
+            throw barobo::Error("unlink " + mPath + ": " + strerror(errno));
+        }
+    }
+
+    void accept () {
+        auto self = shared_from_this();
+        auto session = std::make_shared<Session>(self, mIos);
+        mAcceptor.async_accept(session->server.messageQueue().stream(),
+            [self, session] (boost::system::error_code ec) {
+                if (ec) {
+                    if (ec != boost::asio::error::operation_aborted) {
+                        BOOST_LOG(self->mLog) << "Error accepting client: " << ec.message();
+                    }
+                    return;
+                }
+                self->accept();
+                session->server.messageQueue().asyncHandshake(
+                    [self, session] (boost::system::error_code ec) {
+                        if (ec) {
+                            BOOST_LOG(self->mLog) << "Error in client handshake: " << ec.message();
+                            return;
+                        }
+                        self->serve(session);
+                    });
+            });
+    }
+
+    void serve (std::shared_ptr<Session> session) {
+        if (!mDone) {
+            return;
+        }
+        mSessions.push_back(session);
+        BOOST_LOG(mLog) << "Client connected; " << mSessions.size() << " total";
+        auto self = shared_from_this();
+        rpc::asio::asyncRunServer<barobo::Robot>(session->server, *session,
+            [self, session] (boost::system::error_code ec) {
+                BOOST_LOG(self->mLog) << "Client disconnected: " << ec.message();
+                self->mSessions.remove(session);
+                self->releaseSubscriptions(*session);
+            });
+    }
+
+    // A departed client's subscriptions no longer count towards the union.
+    void releaseSubscriptions (const Session& s) {
+        if (!mDone) {
+            return;
+        }
+        auto log = mLog;
+        auto logError = [log] (boost::system::error_code ec, const auto&) mutable {
+            if (ec) {
+                BOOST_LOG(log) << "Error resubscribing events: " << ec.message();
+            }
+        };
+        if (s.buttonEvents.enable) {
+            resubscribe<MethodIn::enableButtonEvent>(logError);
+        }
+        if (s.anyEncoderEnabled()) {
+            resubscribe<MethodIn::enableEncoderEvent>(logError);
+        }
+        if (s.jointEvents.enable) {
+            resubscribe<MethodIn::enableJointEvent>(logError);
+        }
+        if (s.accelerometerEvents.enable) {
+            resubscribe<MethodIn::enableAccelerometerEvent>(logError);
+        }
+    }
+
+    mutable boost::log::sources::logger mLog;
+    boost::asio::io_service& mIos;
+
+    baromesh::websocket::Connector mConnector;
+    baromesh::WebSocketClient mRobot;
+
+    boost::asio::local::stream_protocol::acceptor mAcceptor;
+    std::string mPath;
+    std::list<std::shared_ptr<Session>> mSessions;
+    std::function<void()> mDone;
+};
+
+template <class In, class Result>
+void Session::onFire (const In& args, rpc::asio::RequestId requestId) {
+    auto self = shared_from_this();
+    broker->fire(args, [self, requestId] (boost::system::error_code ec, Result result) {
+        if (ec) {
+            BOOST_LOG(self->log) << "Error forwarding request: " << ec.message();
+            self->fail(requestId, ec);
+            return;
+        }
+        self->reply(requestId, result);
+    });
+}
+
+template <class In, class Member>
+void subscribe (Session& session, Member Session::*member, const In& args,
+                rpc::asio::RequestId requestId) {
+    using Result = typename rpc::ResultOf<In>::type;
+    session.*member = args;
+    auto self = session.shared_from_this();
+    session.broker->resubscribe<In>(
+        [self, requestId] (boost::system::error_code ec, Result result) {
+            if (ec) {
+                BOOST_LOG(self->log) << "Error resubscribing events: " << ec.message();
+                self->fail(requestId, ec);
+                return;
+            }
+            self->reply(requestId, result);
+        });
+}
+
+void Session::onFire (const MethodIn::enableButtonEvent& args, rpc::asio::RequestId requestId) {
+    subscribe(*this, &Session::buttonEvents, args, requestId);
+}
+
+void Session::onFire (const MethodIn::enableEncoderEvent& args, rpc::asio::RequestId requestId) {
+    subscribe(*this, &Session::encoderEvents, args, requestId);
+}
+
+void Session::onFire (const MethodIn::enableJointEvent& args, rpc::asio::RequestId requestId) {
+    subscribe(*this, &Session::jointEvents, args, requestId);
+}
+
+void Session::onFire (const MethodIn::enableAccelerometerEvent& args, rpc::asio::RequestId requestId) {
+    subscribe(*this, &Session::accelerometerEvents, args, requestId);
+}
+
+} // file namespace
+
+int main (int argc, char** argv) try {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " SERIAL_ID\n";
+        return 1;
+    }
+
+    namespace po = boost::program_options;
+    auto options = po::variables_map{};
+    po::store(po::parse_command_line(argc, argv,
+        baromesh::log::optionsDescription(boost::none)), options);
+    po::notify(options);
+    baromesh::log::initialize("baromesh-broker", options);
+
+    baromesh::IoLease io;
+    auto broker = std::make_shared<Broker>(io.context(), argv[1]);
+
+    auto done = std::make_shared<std::promise<void>>();
+    broker->start([done] { done->set_value(); });
+
+    boost::asio::signal_set signals{io.context(), SIGINT, SIGTERM};
+    signals.async_wait([broker] (boost::system::error_code ec, int) {
+        if (!ec) {
+            broker->stop();
+        }
+    });
+
+    done->get_future().wait();
+    io.context().post([&signals] { signals.cancel(); });
+    broker->disconnect();
+    return 0;
+}
+catch (std::exception& e) {
+    std::cerr << "baromesh-broker: " << e.what() << '\n';
+    return 1;
+}
+
+#else
+
+#include <iostream>
+
+int main () {
+    std::cerr << "baromesh-broker requires Unix-domain sockets\n";
+    return 1;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef BAROMESH_CLOCKSYNC_HPP
+#define BAROMESH_CLOCKSYNC_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace baromesh {
+
+// Estimates the mapping from a robot's clock (milliseconds) to the host's
+// steady clock (microseconds) from request round trips.
+//
+// Each sample is a request sent at host time send, answered with robot
+// timestamp robot, and received at host time receive. The robot read its
+// clock somewhere in between; taking the midpoint bounds the error by half
+// the round trip. The estimator keeps the newest samples and fits
+//
+//     host = 1000 * robot + offset + drift * (robot - mean robot)
+//
+// by least squares, weighting each sample by the inverse square of its round
+// trip so that a few quick round trips outweigh many slow ones.
+class ClockSync {
+public:
+    explicit ClockSync (size_t capacity = 64)
+        : mSamples(std::max(capacity, size_t(2)))
+    {}
+
+    bool valid () const { return mSize > 0; }
+
+    void clear () {
+        mSize = 0;
+        mFit = Fit{};
+    }
+
+    // Replies can arrive out of order, so a sample older than the newest is
+    // stale and ignored. A robot which restarted its clock is a new
+    // connection, and its owner clear()s the estimate.
+    void add (int64_t send, int64_t receive, int robot) {
+        if (receive < send || (mSize && robot < newest().robot)) {
+            return;
+        }
+        mSamples[mHead] = Sample{ (send + receive) / 2.0, double(receive - send), robot };
+        mHead = (mHead + 1) % mSamples.size();
+        mSize = std::min(mSize + 1, mSamples.size());
+        refit();
+    }
+
+    // Host time at which the robot's clock read robot. Requires valid().
+    int64_t toHost (int robot) const {
+        return int64_t(1000.0 * robot + mFit.offset + mFit.drift * (robot - mFit.meanRobot));
+    }
+
+    // Robot time at which the host's clock read host. Requires valid().
+    int toRobot (int64_t host) const {
+        return int((host - mFit.offset + mFit.drift * mFit.meanRobot) / (1000.0 + mFit.drift) + 0.5);
+    }
+
+    // How much faster the robot's clock runs than the host's, in parts per
+    // million. 0 until the samples span some time.
+    double driftPpm () const { return -mFit.drift * 1000.0; }
+
+    // Half the quickest round trip among the samples: a bound on the error
+    // of any one of them, in microseconds.
+    double uncertainty () const { return mFit.minRoundTrip / 2; }
+
+private:
+    struct Sample {
+        double host;       // round-trip midpoint, microseconds
+        double roundTrip;  // microseconds
+        int robot;         // milliseconds
+    };
+
+    struct Fit {
+        double offset = 0;
+        double drift = 0;  // microseconds per millisecond
+        double meanRobot = 0;
+        double minRoundTrip = 0;
+    };
+
+    const Sample& oldest () const {
+        return mSamples[(mHead + mSamples.size() - mSize) % mSamples.size()];
+    }
+
+    const Sample& newest () const {
+        return mSamples[(mHead + mSamples.size() - 1) % mSamples.size()];
+    }
+
+    template <class F>
+    void forEach (F&& f) const {
+        for (size_t i = 0; i < mSize; ++i) {
+            f(mSamples[(mHead + mSamples.size() - mSize + i) % mSamples.size()]);
+        }
+    }
+
+    void refit () {
+        // Weighted means first, then the slope about them, so that the sums
+        // stay small whatever the clocks read.
+        auto minRoundTrip = newest().roundTrip;
+        auto sw = 0.0, sr = 0.0, sy = 0.0;
+        auto weight = [] (const Sample& s) {
+            auto rt = std::max(s.roundTrip, 1.0);
+            return 1.0 / (rt * rt);
+        };
+        forEach([&] (const Sample& s) {
+            auto w = weight(s);
+            sw += w;
+            sr += w * s.robot;
+            sy += w * (s.host - 1000.0 * s.robot);
+            minRoundTrip = std::min(minRoundTrip, s.roundTrip);
+        });
+        auto meanRobot = sr / sw;
+        auto meanOffset = sy / sw;
+        auto srr = 0.0, sry = 0.0;
+        forEach([&] (const Sample& s) {
+            auto w = weight(s);
+            auto dr = s.robot - meanRobot;
+            srr += w * dr * dr;
+            sry += w * dr * (s.host - 1000.0 * s.robot - meanOffset);
+        });
+        mFit.offset = meanOffset;
+        mFit.meanRobot = meanRobot;
+        // Samples a few milliseconds apart say nothing useful about drift.
+        mFit.drift = srr > 0 && newest().robot - oldest().robot > 1000 ? sry / srr : 0;
+        mFit.minRoundTrip = minRoundTrip;
+    }
+
+    std::vector<Sample> mSamples;
+    size_t mHead = 0;
+    size_t mSize = 0;
+    Fit mFit;
+};
+
+} // namespace baromesh
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "gen-daemon.pb.hpp"
 
+#include "endpoint.hpp"
 #include "websocketclient.hpp"
 
 #include <util/asio/asynccompletion.hpp>
@@ -10,15 +11,25 @@
 #include <baromesh/system_error.hpp>
 
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/use_future.hpp>
+
+#include <boost/algorithm/string/case_conv.hpp>
 
 #include <boost/log/sources/logger.hpp>
 #include <boost/log/sources/record_ostream.hpp>
 
 #include <chrono>
+#include <cstdlib>
 #include <functional>
 #include <memory>
+#include <string>
 #include <utility>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #undef M_PI
 #define M_PI 3.14159265358979323846
 
@@ -40,6 +51,49 @@ std::string daemonServiceName () {
     return "42000";
 }
 
+// The daemon's endpoint (see endpoint.hpp). BAROMESH_DAEMON_ENDPOINT
+// overrides the default, e.g. with "unix:/run/baromesh.sock".
+std::string daemonEndpoint () {
+    auto env = std::getenv("BAROMESH_DAEMON_ENDPOINT");
+    if (env && *env) {
+        return env;
+    }
+    return daemonHostName() + ":" + daemonServiceName();
+}
+
+// The directory holding baromesh-broker's sockets: $XDG_RUNTIME_DIR if it is
+// set, else /tmp/baromesh-UID, which the broker creates with mode 0700.
+std::string brokerSocketDirectory () {
+    auto env = std::getenv("XDG_RUNTIME_DIR");
+    if (env && '/' == *env) {
+        return env;
+    }
+#ifndef _WIN32
+    return "/tmp/baromesh-" + std::to_string(getuid());
+#else
+    return "/tmp/baromesh";
+#endif
+}
+
+// True if path is a directory owned by this user which nobody else may enter.
+// Only sockets in such a directory are trusted to belong to our broker.
+bool isPrivateDirectory (const std::string& path) {
+#ifndef _WIN32
+    struct stat st;
+    return 0 == lstat(path.c_str(), &st) && S_ISDIR(st.st_mode)
+        && st.st_uid == getuid() && !(st.st_mode & (S_IRWXG | S_IRWXO));
+#else
+    return false;
+#endif
+}
+
+// Where baromesh-broker listens for clients sharing the robot with the given
+// serial ID.
+std::string brokerSocketPath (std::string serialId) {
+    boost::to_upper(serialId);
+    return brokerSocketDirectory() + "/baromesh-broker-" + serialId + ".sock";
+}
+
 }
 
 using StringPair = std::pair<std::string, std::string>;
@@ -95,6 +149,38 @@ asyncResolveSerialId (WebSocketClient& daemon, std::string serialId, Duration&&
     return init.result.get();
 }
 
+// The endpoint of the robot proxy at a host:service the daemon resolved.
+inline std::string robotEndpoint (const StringPair& hostService) {
+    if (isUnixEndpoint(hostService.first)) {
+        return hostService.first;
+    }
+    return hostService.first + ":" + hostService.second;
+}
+
+// Connect to the daemon, ask it for the host:service of the robot proxy for
+// serialId, and disconnect. A daemon may answer with a host of "unix:/path",
+// in which case the service is meaningless. Blocks; throws on failure. ios
+// must be run by some other thread.
+template <class Duration>
+StringPair resolveSerialId (boost::asio::io_service& ios, const std::string& serialId, Duration timeout) {
+    using boost::asio::use_future;
+    boost::log::sources::logger log;
+    WebSocketClient daemon {ios};
+
+    auto endpoint = daemonEndpoint();
+    BOOST_LOG(log) << "Connecting to the daemon at " << endpoint;
+    websocket::Connector dConnector{ios};
+    connectEndpoint(daemon.messageQueue(), dConnector, endpoint);
+    rpc::asio::asyncConnect<barobo::Daemon>(daemon, timeout, use_future).get();
+
+    auto robot = asyncResolveSerialId(daemon, serialId, timeout, use_future).get();
+
+    BOOST_LOG(log) << "Disconnecting daemon client";
+    asyncDisconnect(daemon, timeout, use_future).get();
+    daemon.close();
+    return robot;
+}
+
 } // namespace baromesh
 
 #endif
@@ -0,0 +1,79 @@
+#ifndef BAROMESH_ENDPOINT_HPP
+#define BAROMESH_ENDPOINT_HPP
+
+#include "inproc.hpp"
+#include "messagequeue.hpp"
+
+#include <baromesh/websocketconnector.hpp>
+
+#include <boost/asio/use_future.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <stdexcept>
+#include <string>
+
+namespace baromesh {
+
+// Endpoints are written "host:service" for a WebSocket, "unix:/path" for
+// SFP-framed messages over a Unix-domain socket, or "inproc://name" for an
+// inproc::Listener in this process. On the local host a Unix socket skips the
+// loopback TCP stack, and with it Nagle and delayed-ACK stalls; inproc skips
+// the kernel altogether.
+
+namespace {
+
+const char kUnixPrefix[] = "unix:";
+const char kInprocPrefix[] = "inproc://";
+
+bool isUnixEndpoint (const std::string& endpoint) {
+    return boost::starts_with(endpoint, kUnixPrefix);
+}
+
+std::string unixEndpointPath (const std::string& endpoint) {
+    return endpoint.substr(sizeof(kUnixPrefix) - 1);
+}
+
+bool isInprocEndpoint (const std::string& endpoint) {
+    return boost::starts_with(endpoint, kInprocPrefix);
+}
+
+std::string inprocEndpointName (const std::string& endpoint) {
+    return endpoint.substr(sizeof(kInprocPrefix) - 1);
+}
+
+// Set up mq's transport and connect it to endpoint. Blocks; throws on
+// failure. A WebSocket connection is made through connector, which must
+// outlive it.
+void connectEndpoint (MessageQueue& mq, websocket::Connector& connector,
+                      const std::string& endpoint) {
+    using boost::asio::use_future;
+    if (isUnixEndpoint(endpoint)) {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        auto& local = mq.emplace<LocalMessageQueue>();
+        local.stream().connect(
+            boost::asio::local::stream_protocol::endpoint{unixEndpointPath(endpoint)});
+        local.asyncHandshake(use_future).get();
+#else
+        throw std::runtime_error("Unix-domain sockets are not supported on this platform");
+#endif
+    }
+    else if (isInprocEndpoint(endpoint)) {
+        inproc::connect(mq.emplace<inproc::MessageQueue>(), inprocEndpointName(endpoint));
+    }
+    else {
+        auto colon = endpoint.rfind(':');
+        if (colon == std::string::npos) {
+            throw std::runtime_error("Malformed endpoint " + endpoint + ", expected host:service");
+        }
+        auto& ws = mq.emplace<websocket::Connector::MessageQueue>();
+        connector.asyncConnect(ws, endpoint.substr(0, colon), endpoint.substr(colon + 1),
+            use_future).get();
+    }
+}
+
+} // file namespace
+
+} // namespace baromesh
+
+#endif
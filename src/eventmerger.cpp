@@ -0,0 +1,181 @@
+#include <baromesh/eventmerger.hpp>
+
+#include "reorderbuffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace barobo {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Host steady-clock time in microseconds, as in StateObserver.
+int64_t hostNow () {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+} // file namespace
+
+struct EventMerger::Impl {
+    // Feeds one robot's events into the merge.
+    struct Source : StateObserver {
+        Source (Impl& m, size_t i, Linkbot& l) : merger(m), index(i), linkbot(l) {}
+
+        virtual void onJointAngle (int joint, double degrees, int timestamp, int64_t hostTime) {
+            auto e = event(MergedEvent::JOINT_ANGLE, timestamp);
+            e.joint = joint;
+            e.degrees = degrees;
+            merger.push(index, sampleTime(timestamp, hostTime), e);
+        }
+
+        virtual void onJointState (int joint, JointState::Type state, int timestamp, int64_t hostTime) {
+            auto e = event(MergedEvent::JOINT_STATE, timestamp);
+            e.joint = joint;
+            e.state = state;
+            merger.push(index, sampleTime(timestamp, hostTime), e);
+        }
+
+        virtual void onAccelerometer (double x, double y, double z, int timestamp, int64_t hostTime) {
+            auto e = event(MergedEvent::ACCELEROMETER, timestamp);
+            e.accel[0] = x;
+            e.accel[1] = y;
+            e.accel[2] = z;
+            merger.push(index, sampleTime(timestamp, hostTime), e);
+        }
+
+        MergedEvent event (MergedEvent::Type type, int timestamp) const {
+            auto e = MergedEvent{};
+            e.type = type;
+            e.source = index;
+            e.timestamp = timestamp;
+            return e;
+        }
+
+        // When the robot sampled the event, if it said and its clock is
+        // known, otherwise when the event arrived.
+        int64_t sampleTime (int timestamp, int64_t hostTime) const {
+            auto t = timestamp ? linkbot.toHostTime(timestamp) : 0;
+            return t ? t : hostTime;
+        }
+
+        Impl& merger;
+        size_t index;
+        Linkbot& linkbot;
+    };
+
+    Impl (int64_t window, size_t capacity) : buffer(window, capacity) {}
+
+    void push (size_t source, int64_t time, const MergedEvent& e) {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            buffer.push(source, time, e);
+        }
+        ready.notify_one();
+    }
+
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    baromesh::ReorderBuffer<MergedEvent> buffer;
+    std::vector<std::unique_ptr<Source>> sources;  // null once removed
+};
+
+EventMerger::EventMerger (int64_t windowMicroseconds, size_t capacity)
+    : m(new Impl(windowMicroseconds, capacity))
+{}
+
+EventMerger::~EventMerger () {
+    for (size_t i = 0; i < m->sources.size(); ++i) {
+        remove(i);
+    }
+    delete m;
+}
+
+size_t EventMerger::add (Linkbot& linkbot, double encoderGranularity) {
+    linkbot.synchronizeClock();
+    Impl::Source* source;
+    {
+        std::lock_guard<std::mutex> lock{m->mutex};
+        auto index = m->buffer.addSource();
+        m->sources.emplace_back(new Impl::Source{*m, index, linkbot});
+        source = m->sources.back().get();
+    }
+    try {
+        linkbot.addStateObserver(source, encoderGranularity);
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock{m->mutex};
+        m->buffer.removeSource(source->index);
+        m->sources[source->index].reset();
+        throw;
+    }
+    return source->index;
+}
+
+void EventMerger::remove (size_t index) {
+    Impl::Source* source;
+    {
+        std::lock_guard<std::mutex> lock{m->mutex};
+        if (index >= m->sources.size() || !m->sources[index]) {
+            return;
+        }
+        source = m->sources[index].get();
+    }
+    // Once this returns, the source's observer callbacks have finished; they
+    // take the merger's lock, so it must not be held here.
+    auto ec = boost::system::error_code{};
+    source->linkbot.removeStateObserver(source, ec);
+    {
+        std::lock_guard<std::mutex> lock{m->mutex};
+        m->buffer.removeSource(index);
+        m->sources[index].reset();
+    }
+    m->ready.notify_all();
+}
+
+bool EventMerger::next (MergedEvent& event, int timeoutMs) {
+    auto end = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    std::unique_lock<std::mutex> lock{m->mutex};
+    for (;;) {
+        auto time = int64_t{};
+        if (m->buffer.pop(hostNow(), event, time)) {
+            event.hostTime = time;
+            return true;
+        }
+        if (Clock::now() >= end) {
+            return false;
+        }
+        // Sleep until the oldest event's window closes or another arrives.
+        auto wake = end;
+        auto deadline = m->buffer.deadline();
+        if (deadline != std::numeric_limits<int64_t>::max()) {
+            wake = std::min(wake, Clock::time_point{
+                std::chrono::duration_cast<Clock::duration>(std::chrono::microseconds{deadline})});
+        }
+        m->ready.wait_until(lock, wake);
+    }
+}
+
+size_t EventMerger::queued () const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    return m->buffer.size();
+}
+
+uint64_t EventMerger::lateEvents () const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    return m->buffer.late();
+}
+
+uint64_t EventMerger::droppedEvents () const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    return m->buffer.overflowed();
+}
+
+} // namespace barobo
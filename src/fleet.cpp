@@ -0,0 +1,206 @@
+#include <baromesh/fleet.hpp>
+#include <baromesh/error.hpp>
+
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <stdint.h>
+
+#undef M_PI
+#define M_PI 3.14159265358979323846
+
+namespace barobo {
+
+struct FleetTable::Impl {
+    // Feeds one row of the table from a Linkbot's state updates.
+    struct Row : StateObserver {
+        Row (Impl& t, size_t r, Linkbot& l) : table(t), row(r), linkbot(&l) {}
+
+        virtual void onJointAngle (int joint, double degrees, int, int64_t) {
+            if (joint >= 0 && joint < 3) {
+                std::lock_guard<std::mutex> lock{table.mutex};
+                table.angle[joint][row] = float(degrees);
+            }
+        }
+
+        virtual void onJointState (int joint, JointState::Type state, int, int64_t) {
+            if (joint >= 0 && joint < 3) {
+                std::lock_guard<std::mutex> lock{table.mutex};
+                table.state[joint][row] = uint8_t(state);
+            }
+        }
+
+        virtual void onAccelerometer (double x, double y, double z, int, int64_t) {
+            std::lock_guard<std::mutex> lock{table.mutex};
+            table.accel[0][row] = float(x);
+            table.accel[1][row] = float(y);
+            table.accel[2][row] = float(z);
+        }
+
+        virtual void onBatteryVoltage (double volts, int64_t) {
+            std::lock_guard<std::mutex> lock{table.mutex};
+            table.battery[row] = float(volts);
+        }
+
+        Impl& table;
+        size_t row;
+        Linkbot* linkbot;
+    };
+
+    // Turn a per-row hit column into a list of live row indices.
+    std::vector<size_t> collect (const std::vector<uint8_t>& hit) const {
+        auto rows = std::vector<size_t>{};
+        for (size_t i = 0; i < hit.size(); ++i) {
+            if (hit[i] & live[i]) {
+                rows.push_back(i);
+            }
+        }
+        return rows;
+    }
+
+    mutable std::mutex mutex;
+
+    // Structure of arrays: one contiguous column per quantity.
+    std::vector<float> angle[3];
+    std::vector<float> accel[3];
+    std::vector<uint8_t> state[3];
+    std::vector<float> battery;
+    std::vector<uint8_t> live;
+
+    std::vector<std::unique_ptr<Row>> rows;
+};
+
+FleetTable::FleetTable () : m(new Impl) {}
+
+FleetTable::~FleetTable () {
+    for (auto& row : m->rows) {
+        if (row && row->linkbot) {
+            auto ec = boost::system::error_code{};
+            row->linkbot->removeStateObserver(row.get(), ec);
+        }
+    }
+    delete m;
+}
+
+size_t FleetTable::add (Linkbot& linkbot, double encoderGranularity) {
+    size_t index;
+    Impl::Row* row;
+    {
+        std::lock_guard<std::mutex> lock{m->mutex};
+        index = m->rows.size();
+        for (auto& column : m->angle) { column.push_back(0); }
+        for (auto& column : m->accel) { column.push_back(0); }
+        for (auto& column : m->state) { column.push_back(JointState::COAST); }
+        m->battery.push_back(0);
+        m->live.push_back(1);
+        m->rows.emplace_back(new Impl::Row{*m, index, linkbot});
+        row = m->rows.back().get();
+    }
+    try {
+        linkbot.addStateObserver(row, encoderGranularity);
+    }
+    catch (Error&) {
+        std::lock_guard<std::mutex> lock{m->mutex};
+        m->live[index] = 0;
+        row->linkbot = nullptr;
+        throw;
+    }
+    return index;
+}
+
+void FleetTable::remove (size_t row) {
+    Linkbot* linkbot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock{m->mutex};
+        if (row >= m->rows.size()) {
+            return;
+        }
+        m->live[row] = 0;
+        std::swap(linkbot, m->rows[row]->linkbot);
+    }
+    if (linkbot) {
+        auto ec = boost::system::error_code{};
+        linkbot->removeStateObserver(m->rows[row].get(), ec);
+    }
+}
+
+size_t FleetTable::size () const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    return m->rows.size();
+}
+
+void FleetTable::get (size_t row, double angles[3], double accel[3],
+                      JointState::Type states[3], double& batteryVoltage) const
+{
+    std::lock_guard<std::mutex> lock{m->mutex};
+    if (row >= m->rows.size()) {
+        throw Error("FleetTable row out of range");
+    }
+    for (int j = 0; j < 3; ++j) {
+        angles[j] = m->angle[j][row];
+        accel[j] = m->accel[j][row];
+        states[j] = JointState::Type(m->state[j][row]);
+    }
+    batteryVoltage = m->battery[row];
+}
+
+std::vector<size_t> FleetTable::jointBeyond (double degrees) const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    auto n = m->battery.size();
+    auto limit = float(degrees);
+    auto a0 = m->angle[0].data();
+    auto a1 = m->angle[1].data();
+    auto a2 = m->angle[2].data();
+    auto hit = std::vector<uint8_t>(n);
+    for (size_t i = 0; i < n; ++i) {
+        hit[i] = (std::fabs(a0[i]) > limit) | (std::fabs(a1[i]) > limit)
+               | (std::fabs(a2[i]) > limit);
+    }
+    return m->collect(hit);
+}
+
+std::vector<size_t> FleetTable::tiltExceeds (double degrees) const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    auto n = m->battery.size();
+    // tilt > limit  <=>  z < |a| cos(limit)
+    auto cosLimit = float(std::cos(degrees * M_PI / 180.0));
+    auto x = m->accel[0].data();
+    auto y = m->accel[1].data();
+    auto z = m->accel[2].data();
+    auto hit = std::vector<uint8_t>(n);
+    for (size_t i = 0; i < n; ++i) {
+        auto norm = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        hit[i] = (norm > 0) & (z[i] < norm * cosLimit);
+    }
+    return m->collect(hit);
+}
+
+std::vector<size_t> FleetTable::jointInState (JointState::Type state) const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    auto n = m->battery.size();
+    auto wanted = uint8_t(state);
+    auto s0 = m->state[0].data();
+    auto s1 = m->state[1].data();
+    auto s2 = m->state[2].data();
+    auto hit = std::vector<uint8_t>(n);
+    for (size_t i = 0; i < n; ++i) {
+        hit[i] = (s0[i] == wanted) | (s1[i] == wanted) | (s2[i] == wanted);
+    }
+    return m->collect(hit);
+}
+
+std::vector<size_t> FleetTable::batteryBelow (double volts) const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    auto n = m->battery.size();
+    auto limit = float(volts);
+    auto v = m->battery.data();
+    auto hit = std::vector<uint8_t>(n);
+    for (size_t i = 0; i < n; ++i) {
+        hit[i] = (v[i] > 0) & (v[i] < limit);
+    }
+    return m->collect(hit);
+}
+
+} // namespace barobo
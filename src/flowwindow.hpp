@@ -0,0 +1,263 @@
+#ifndef BAROMESH_FLOWWINDOW_HPP
+#define BAROMESH_FLOWWINDOW_HPP
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+#include <stdint.h>
+
+namespace baromesh {
+
+// Limits the requests outstanding on one robot link, adapting the limit in
+// the style of TCP congestion control. Each completion grows the window by
+// 1/window, i.e., by one request per round trip, as long as the round trip
+// stays near the quickest one seen recently. A timeout, or a round trip
+// inflated well past that baseline, halves the window, at most once per
+// window's worth of completions so that one burst of trouble counts once.
+//
+// Requests beyond the window wait in a FIFO queue and are started as earlier
+// ones complete, on whichever thread completes them. A request which fits in
+// the window is started by its caller and never touches the queue. Urgent
+// requests skip the queue and the window, and may take queued requests which
+// they supersede out of the queue.
+class FlowWindow {
+public:
+    // A request waiting for room in the window. Requests are linked into the
+    // queue intrusively, so queueing one allocates nothing beyond the request.
+    // The window owns a queued request: it calls start() once the window has
+    // room, or abort() if cancelQueued() takes the request out of the queue,
+    // and then deletes it.
+    class Request {
+    public:
+        virtual ~Request () {}
+        virtual void start () = 0;
+        // Only cancellable requests are aborted by cancelQueued().
+        virtual bool cancellable () const { return false; }
+        virtual void abort () {}
+
+    private:
+        friend class FlowWindow;
+        Request* mNext = nullptr;
+    };
+
+    explicit FlowWindow (unsigned maxWindow = 32)
+        : mMax(std::max(1u, maxWindow))
+        , mWindow(std::min(double(kInitialWindow), double(mMax)))
+    {}
+
+    ~FlowWindow () {
+        while (mHead) {
+            auto next = mHead->mNext;
+            delete mHead;
+            mHead = next;
+        }
+    }
+
+    FlowWindow (const FlowWindow&) = delete;
+    FlowWindow& operator= (const FlowWindow&) = delete;
+
+    // Claim room for a request which the caller starts right away. Returns
+    // false if the window is full, or others are already waiting; submit()
+    // the request instead. A claimed request must eventually lead to exactly
+    // one complete().
+    bool tryAcquire () {
+        std::lock_guard<std::mutex> lock{mMutex};
+        if (mInFlight >= limit() || mHead) {
+            return false;
+        }
+        ++mInFlight;
+        return true;
+    }
+
+    // Start request now if the window has room, otherwise once it does.
+    // start() must eventually lead to exactly one complete().
+    void submit (Request* request) {
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            if (mInFlight >= limit() || mHead) {
+                append(request);
+                return;
+            }
+            ++mInFlight;
+        }
+        run(request);
+    }
+
+    // Claim room for an urgent request, whatever the window and the queue
+    // hold. It still counts as in flight, and must still lead to one
+    // complete().
+    void acquireUrgent () {
+        std::lock_guard<std::mutex> lock{mMutex};
+        ++mInFlight;
+    }
+
+    // Take every cancellable request out of the queue and abort it.
+    void cancelQueued () {
+        Request* aborted = nullptr;
+        Request** abortedTail = &aborted;
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            auto kept = mHead;
+            mHead = mTail = nullptr;
+            mQueued = 0;
+            while (kept) {
+                auto next = kept->mNext;
+                kept->mNext = nullptr;
+                if (kept->cancellable()) {
+                    *abortedTail = kept;
+                    abortedTail = &kept->mNext;
+                }
+                else {
+                    append(kept);
+                }
+                kept = next;
+            }
+        }
+        while (aborted) {
+            auto next = aborted->mNext;
+            aborted->abort();
+            delete aborted;
+            aborted = next;
+        }
+    }
+
+    // A request finished after roundTrip microseconds. lost means it timed
+    // out; a request which failed for any other reason says nothing about
+    // congestion and should pass lost = false and roundTrip = 0.
+    void complete (int64_t roundTrip, bool lost) {
+        Request* ready;
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            --mInFlight;
+            adapt(roundTrip, lost);
+            ready = startable();
+        }
+        run(ready);
+    }
+
+    void setMaxWindow (unsigned maxWindow) {
+        Request* ready;
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            mMax = std::max(1u, maxWindow);
+            mWindow = std::min(mWindow, double(mMax));
+            ready = startable();
+        }
+        run(ready);
+    }
+
+    struct Stats {
+        double window;
+        unsigned inFlight;
+        unsigned queued;
+        double smoothedRoundTrip;  // microseconds
+        uint64_t decreases;
+    };
+
+    Stats stats () const {
+        std::lock_guard<std::mutex> lock{mMutex};
+        return Stats{ mWindow, mInFlight, mQueued, mSmoothedRoundTrip, mDecreases };
+    }
+
+private:
+    static constexpr double kInitialWindow = 4;
+    // A round trip this many times the baseline, plus the slack, is congestion.
+    static constexpr double kInflation = 2;
+    static constexpr int64_t kSlack = 1000;  // microseconds
+    // The baseline is the quickest round trip of the last one or two epochs,
+    // so it can rise again if the link itself gets slower.
+    static constexpr unsigned kEpoch = 256;
+
+    unsigned limit () const { return unsigned(mWindow); }
+
+    void append (Request* request) {
+        request->mNext = nullptr;
+        if (mTail) {
+            mTail->mNext = request;
+        }
+        else {
+            mHead = request;
+        }
+        mTail = request;
+        ++mQueued;
+    }
+
+    // Unlink and return, as a list, the queued requests which now fit in the
+    // window.
+    Request* startable () {
+        Request* ready = nullptr;
+        Request** tail = &ready;
+        while (mInFlight < limit() && mHead) {
+            *tail = mHead;
+            tail = &mHead->mNext;
+            mHead = mHead->mNext;
+            --mQueued;
+            ++mInFlight;
+        }
+        *tail = nullptr;
+        if (!mHead) {
+            mTail = nullptr;
+        }
+        return ready;
+    }
+
+    // Start and delete each request in a list, without the lock held.
+    static void run (Request* list) {
+        while (list) {
+            auto next = list->mNext;
+            list->start();
+            delete list;
+            list = next;
+        }
+    }
+
+    void adapt (int64_t roundTrip, bool lost) {
+        ++mSinceDecrease;
+        if (!lost && roundTrip <= 0) {
+            return;
+        }
+        if (!lost) {
+            mSmoothedRoundTrip = mSmoothedRoundTrip
+                ? mSmoothedRoundTrip + (roundTrip - mSmoothedRoundTrip) / 8
+                : double(roundTrip);
+            mEpochMin = std::min(mEpochMin, roundTrip);
+            if (++mEpochCount == kEpoch) {
+                mPreviousEpochMin = mEpochMin;
+                mEpochMin = std::numeric_limits<int64_t>::max();
+                mEpochCount = 0;
+            }
+        }
+        auto baseline = std::min(mEpochMin, mPreviousEpochMin);
+        auto inflated = !lost && roundTrip > kInflation * baseline + kSlack;
+        if (lost || inflated) {
+            if (mSinceDecrease >= limit()) {
+                mWindow = std::max(1.0, mWindow / 2);
+                mSinceDecrease = 0;
+                ++mDecreases;
+            }
+        }
+        else {
+            mWindow = std::min(double(mMax), mWindow + 1 / mWindow);
+        }
+    }
+
+    mutable std::mutex mMutex;
+    unsigned mMax;
+    double mWindow;
+    unsigned mInFlight = 0;
+    Request* mHead = nullptr;  // the queue
+    Request* mTail = nullptr;
+    unsigned mQueued = 0;
+
+    double mSmoothedRoundTrip = 0;
+    int64_t mEpochMin = std::numeric_limits<int64_t>::max();
+    int64_t mPreviousEpochMin = std::numeric_limits<int64_t>::max();
+    unsigned mEpochCount = 0;
+    unsigned mSinceDecrease = 0;
+    uint64_t mDecreases = 0;
+};
+
+} // namespace baromesh
+
+#endif
@@ -0,0 +1,316 @@
+#ifndef BAROMESH_INPROC_HPP
+#define BAROMESH_INPROC_HPP
+
+#include <util/asio/asynccompletion.hpp>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/io_service.hpp>
+
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace baromesh {
+
+// An in-process message transport, for running a robot implementation (such
+// as the simulator) in the same binary as the Linkbots talking to it.
+// Messages are handed straight to the peer: the sender's encoded buffer is
+// copied once, into the receiver's buffer if a receive is waiting, otherwise
+// into the peer's inbox.
+//
+// A Listener binds a name; connect() opens a connection to it, whose other
+// end the Listener hands out through asyncAccept(). Linkbot reaches a
+// listener through the endpoint "inproc://name".
+namespace inproc {
+
+typedef void SendHandlerSignature(boost::system::error_code);
+typedef void ReceiveHandlerSignature(boost::system::error_code, size_t);
+typedef void AcceptHandlerSignature(boost::system::error_code);
+
+// The shared state of a connected pair of MessageQueues, one per side.
+class Pipe {
+public:
+    struct Side {
+        boost::asio::io_service* ios = nullptr;
+        std::deque<std::vector<uint8_t>> inbox;
+        boost::asio::mutable_buffer receiveBuffer;
+        std::function<ReceiveHandlerSignature> receiveHandler;
+        bool closed = false;
+    };
+
+    void send (int from, boost::asio::const_buffer buffer,
+               std::function<SendHandlerSignature> handler) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        auto& self = mSides[from];
+        auto& peer = mSides[!from];
+        auto data = boost::asio::buffer_cast<const uint8_t*>(buffer);
+        auto size = boost::asio::buffer_size(buffer);
+        if (self.closed) {
+            self.ios->post(std::bind(handler, boost::asio::error::operation_aborted));
+            return;
+        }
+        if (peer.closed) {
+            self.ios->post(std::bind(handler, boost::asio::error::broken_pipe));
+            return;
+        }
+        if (peer.receiveHandler) {
+            deliver(peer, data, size);
+        }
+        else {
+            peer.inbox.emplace_back(data, data + size);
+        }
+        self.ios->post(std::bind(handler, boost::system::error_code{}));
+    }
+
+    void receive (int at, boost::asio::mutable_buffer buffer,
+                  std::function<ReceiveHandlerSignature> handler) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        auto& self = mSides[at];
+        if (self.closed) {
+            self.ios->post(std::bind(handler, boost::asio::error::operation_aborted, size_t(0)));
+            return;
+        }
+        self.receiveBuffer = buffer;
+        self.receiveHandler = std::move(handler);
+        if (!self.inbox.empty()) {
+            auto message = std::move(self.inbox.front());
+            self.inbox.pop_front();
+            deliver(self, message.data(), message.size());
+        }
+        else if (mSides[!at].closed) {
+            fail(self, boost::asio::error::eof);
+        }
+    }
+
+    void close (int at) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        auto& self = mSides[at];
+        auto& peer = mSides[!at];
+        if (self.closed) {
+            return;
+        }
+        self.closed = true;
+        self.inbox.clear();
+        if (self.receiveHandler) {
+            fail(self, boost::asio::error::operation_aborted);
+        }
+        if (peer.receiveHandler && peer.inbox.empty()) {
+            fail(peer, boost::asio::error::eof);
+        }
+    }
+
+    void attach (int at, boost::asio::io_service& ios) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mSides[at].ios = &ios;
+    }
+
+private:
+    // Complete side's waiting receive with a message.
+    static void deliver (Side& side, const uint8_t* data, size_t size) {
+        auto handler = std::move(side.receiveHandler);
+        side.receiveHandler = nullptr;
+        if (size > boost::asio::buffer_size(side.receiveBuffer)) {
+            side.ios->post(std::bind(handler, boost::asio::error::message_size, size_t(0)));
+            return;
+        }
+        memcpy(boost::asio::buffer_cast<uint8_t*>(side.receiveBuffer), data, size);
+        side.ios->post(std::bind(handler, boost::system::error_code{}, size));
+    }
+
+    static void fail (Side& side, boost::system::error_code ec) {
+        auto handler = std::move(side.receiveHandler);
+        side.receiveHandler = nullptr;
+        side.ios->post(std::bind(handler, ec, size_t(0)));
+    }
+
+    std::mutex mMutex;
+    Side mSides[2];
+};
+
+// One end of an in-process connection. Models the same asyncSend /
+// asyncReceive / close interface as the other message queues.
+class MessageQueue {
+public:
+    explicit MessageQueue (boost::asio::io_service& ios) : mIos(ios) {}
+
+    ~MessageQueue () {
+        close();
+    }
+
+    template <class Handler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Handler, SendHandlerSignature)
+    asyncSend (boost::asio::const_buffer buffer, Handler&& handler) {
+        util::asio::AsyncCompletion<
+            Handler, SendHandlerSignature
+        > init { std::forward<Handler>(handler) };
+        if (mPipe) {
+            mPipe->send(mSide, buffer, init.handler);
+        }
+        else {
+            mIos.post(std::bind(init.handler, boost::asio::error::not_connected));
+        }
+        return init.result.get();
+    }
+
+    template <class Handler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Handler, ReceiveHandlerSignature)
+    asyncReceive (boost::asio::mutable_buffer buffer, Handler&& handler) {
+        util::asio::AsyncCompletion<
+            Handler, ReceiveHandlerSignature
+        > init { std::forward<Handler>(handler) };
+        if (mPipe) {
+            mPipe->receive(mSide, buffer, init.handler);
+        }
+        else {
+            mIos.post(std::bind(init.handler, boost::asio::error::not_connected, size_t(0)));
+        }
+        return init.result.get();
+    }
+
+    void close () {
+        if (mPipe) {
+            mPipe->close(mSide);
+        }
+    }
+
+    boost::asio::io_service& get_io_service () {
+        return mIos;
+    }
+
+    // Become side of pipe. Used by connect() and Listener.
+    void attach (std::shared_ptr<Pipe> pipe, int side) {
+        close();
+        pipe->attach(side, mIos);
+        mPipe = std::move(pipe);
+        mSide = side;
+    }
+
+private:
+    boost::asio::io_service& mIos;
+    std::shared_ptr<Pipe> mPipe;
+    int mSide = 0;
+};
+
+class Listener;
+
+// Names bound by live Listeners.
+class Registry {
+public:
+    static Registry& global () {
+        static Registry r;
+        return r;
+    }
+
+    void bind (const std::string& name, Listener* listener) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        if (!mListeners.emplace(name, listener).second) {
+            throw std::runtime_error("inproc://" + name + " is already bound");
+        }
+    }
+
+    void unbind (const std::string& name) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mListeners.erase(name);
+    }
+
+    // Call f with the listener bound to name, or throw.
+    template <class F>
+    void with (const std::string& name, F&& f) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        auto it = mListeners.find(name);
+        if (it == mListeners.end()) {
+            throw std::runtime_error("Nothing listening at inproc://" + name);
+        }
+        f(*it->second);
+    }
+
+private:
+    std::mutex mMutex;
+    std::map<std::string, Listener*> mListeners;
+};
+
+class Listener {
+public:
+    Listener (boost::asio::io_service& ios, const std::string& name)
+        : mIos(ios), mName(name)
+    {
+        Registry::global().bind(mName, this);
+    }
+
+    ~Listener () {
+        Registry::global().unbind(mName);
+        std::lock_guard<std::mutex> lock{mMutex};
+        for (auto& pipe : mBacklog) {
+            pipe->close(1);
+        }
+        if (mAcceptHandler) {
+            mIos.post(std::bind(mAcceptHandler, boost::asio::error::operation_aborted));
+        }
+    }
+
+    // Attach the next incoming connection to peer.
+    template <class Handler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Handler, AcceptHandlerSignature)
+    asyncAccept (MessageQueue& peer, Handler&& handler) {
+        util::asio::AsyncCompletion<
+            Handler, AcceptHandlerSignature
+        > init { std::forward<Handler>(handler) };
+        std::lock_guard<std::mutex> lock{mMutex};
+        if (!mBacklog.empty()) {
+            peer.attach(mBacklog.front(), 1);
+            mBacklog.pop_front();
+            mIos.post(std::bind(init.handler, boost::system::error_code{}));
+        }
+        else {
+            mPeer = &peer;
+            mAcceptHandler = init.handler;
+        }
+        return init.result.get();
+    }
+
+    // Called by connect() with the registry locked.
+    void incoming (std::shared_ptr<Pipe> pipe) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        if (mAcceptHandler) {
+            mPeer->attach(pipe, 1);
+            mIos.post(std::bind(mAcceptHandler, boost::system::error_code{}));
+            mAcceptHandler = nullptr;
+            mPeer = nullptr;
+        }
+        else {
+            mBacklog.push_back(pipe);
+        }
+    }
+
+private:
+    boost::asio::io_service& mIos;
+    std::string mName;
+
+    std::mutex mMutex;
+    std::deque<std::shared_ptr<Pipe>> mBacklog;
+    MessageQueue* mPeer = nullptr;
+    std::function<AcceptHandlerSignature> mAcceptHandler;
+};
+
+// Connect mq to the Listener bound to name. Throws if there is none.
+inline void connect (MessageQueue& mq, const std::string& name) {
+    auto pipe = std::make_shared<Pipe>();
+    mq.attach(pipe, 0);
+    Registry::global().with(name, [&pipe] (Listener& l) {
+        l.incoming(pipe);
+    });
+}
+
+} // namespace inproc
+
+} // namespace baromesh
+
+#endif
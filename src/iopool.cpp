@@ -0,0 +1,114 @@
+#include "iopool.hpp"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace baromesh {
+
+namespace {
+
+// Spin budget used by blocking calls when busy polling is enabled. Long
+// enough to cover a local round trip, short enough that a robot on a slow
+// radio link does not burn a core for the whole request.
+const std::chrono::microseconds kBusyPollSpinBudget{50};
+
+// Pin the calling thread to a single CPU. Best-effort: platforms without an
+// affinity API are left alone.
+void pinCurrentThread (unsigned cpu) {
+#ifdef _WIN32
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+} // file namespace
+
+PollThread::PollThread (int cpu)
+    : mWork(mContext)
+    , mStop(false)
+    , mThread([this, cpu] {
+        if (cpu >= 0) {
+            pinCurrentThread(unsigned(cpu));
+        }
+        while (!mStop.load(std::memory_order_relaxed)) {
+            mContext.poll();
+        }
+    })
+{}
+
+PollThread::~PollThread () {
+    mStop = true;
+    mThread.join();
+}
+
+IoPool& IoPool::global () {
+    static IoPool pool;
+    return pool;
+}
+
+void IoPool::configure (unsigned threadCount, bool pinThreads, bool busyPoll) {
+    auto shards = std::vector<std::shared_ptr<Shard>>{};
+    // One plain thread is the library's global I/O thread, which is shared
+    // with other users and so is never pinned; pinning gets a thread of its
+    // own.
+    if (threadCount > 1 || busyPoll || pinThreads) {
+        auto cpus = std::max(1u, std::thread::hardware_concurrency());
+        for (auto i = 0u; i < std::max(1u, threadCount); ++i) {
+            auto cpu = i % cpus;
+            if (busyPoll) {
+                auto poller = std::unique_ptr<PollThread>{
+                    new PollThread{pinThreads ? int(cpu) : -1}
+                };
+                shards.push_back(std::make_shared<Shard>(std::move(poller), i));
+            }
+            else {
+                auto thread = std::make_shared<util::asio::IoThread>();
+                if (pinThreads) {
+                    thread->context().post([cpu] { pinCurrentThread(cpu); });
+                }
+                shards.push_back(std::make_shared<Shard>(thread, i));
+            }
+        }
+    }
+    auto spin = busyPoll ? std::chrono::nanoseconds{kBusyPollSpinBudget}
+                         : std::chrono::nanoseconds::zero();
+    std::lock_guard<std::mutex> lock{mMutex};
+    mShards = std::move(shards);
+    mSpinBudget.store(spin.count(), std::memory_order_relaxed);
+}
+
+std::shared_ptr<IoPool::Shard> IoPool::acquire () {
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (mShards.empty()) {
+        mShards.push_back(std::make_shared<Shard>(util::asio::IoThread::getGlobal(), 0));
+    }
+    auto shard = *std::min_element(mShards.begin(), mShards.end(),
+        [] (const std::shared_ptr<Shard>& a, const std::shared_ptr<Shard>& b) {
+            return a->load < b->load;
+        });
+    ++shard->load;
+    return shard;
+}
+
+std::vector<unsigned> IoPool::loads () const {
+    std::lock_guard<std::mutex> lock{mMutex};
+    auto result = std::vector<unsigned>{};
+    for (auto& shard : mShards) {
+        result.push_back(shard->load);
+    }
+    return result;
+}
+
+} // namespace baromesh
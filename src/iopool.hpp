@@ -0,0 +1,106 @@
+#ifndef BAROMESH_IOPOOL_HPP
+#define BAROMESH_IOPOOL_HPP
+
+#include <util/asio/iothread.hpp>
+
+#include <boost/asio/io_service.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace baromesh {
+
+// A dedicated thread which spins on io_service::poll() instead of sleeping in
+// io_service::run(). Trades a whole CPU for the wakeup latency of the I/O
+// thread.
+class PollThread {
+public:
+    // Pin the thread to the given CPU, or leave it floating if cpu < 0.
+    explicit PollThread (int cpu);
+    ~PollThread ();
+
+    PollThread (const PollThread&) = delete;
+    PollThread& operator= (const PollThread&) = delete;
+
+    boost::asio::io_service& context () { return mContext; }
+
+private:
+    boost::asio::io_service mContext;
+    boost::asio::io_service::work mWork;
+    std::atomic<bool> mStop;
+    std::thread mThread;
+};
+
+// A set of I/O threads which Linkbots are sharded across. Until configure()
+// is called with more than one thread, or with busy polling, every lease
+// refers to the process-wide util::asio::IoThread::getGlobal().
+class IoPool {
+public:
+    struct Shard {
+        Shard (std::shared_ptr<util::asio::IoThread> t, unsigned i)
+            : thread(std::move(t)), index(i), load(0) {}
+
+        Shard (std::unique_ptr<PollThread> p, unsigned i)
+            : poller(std::move(p)), index(i), load(0) {}
+
+        boost::asio::io_service& context () {
+            return poller ? poller->context() : thread->context();
+        }
+
+        std::shared_ptr<util::asio::IoThread> thread;
+        std::unique_ptr<PollThread> poller;
+        unsigned index;
+        std::atomic<unsigned> load;
+    };
+
+    static IoPool& global ();
+
+    // Replace the pool with threadCount threads. If pinThreads is true, shard
+    // i is pinned to CPU i modulo the number of CPUs, even if it is the only
+    // one. If busyPoll is true, the
+    // threads are PollThreads and blocking calls spin for spinBudget() before
+    // they sleep. Connections already assigned to the old threads keep them
+    // alive until they close.
+    void configure (unsigned threadCount, bool pinThreads, bool busyPoll);
+
+    // Pick the least-loaded shard.
+    std::shared_ptr<Shard> acquire ();
+
+    std::vector<unsigned> loads () const;
+
+    // How long a blocking call should spin waiting for its reply before
+    // parking. Zero unless busy polling is enabled.
+    std::chrono::nanoseconds spinBudget () const {
+        return std::chrono::nanoseconds{mSpinBudget.load(std::memory_order_relaxed)};
+    }
+
+private:
+    mutable std::mutex mMutex;
+    std::vector<std::shared_ptr<Shard>> mShards;
+    std::atomic<std::chrono::nanoseconds::rep> mSpinBudget{0};
+};
+
+// RAII handle to an IoPool shard. Holds one unit of the shard's load until
+// destroyed.
+class IoLease {
+public:
+    IoLease () : mShard(IoPool::global().acquire()) {}
+    ~IoLease () { --mShard->load; }
+
+    IoLease (const IoLease&) = delete;
+    IoLease& operator= (const IoLease&) = delete;
+
+    boost::asio::io_service& context () const { return mShard->context(); }
+    unsigned shard () const { return mShard->index; }
+
+private:
+    std::shared_ptr<IoPool::Shard> mShard;
+};
+
+} // namespace baromesh
+
+#endif
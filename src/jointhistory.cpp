@@ -0,0 +1,99 @@
+#include <baromesh/jointhistory.hpp>
+
+#include "anglehistory.hpp"
+
+#include <mutex>
+
+namespace barobo {
+
+struct JointHistory::Impl : StateObserver {
+    Impl (Linkbot& l, size_t capacity)
+        : linkbot(l)
+        , joints{baromesh::AngleHistory{capacity},
+                 baromesh::AngleHistory{capacity},
+                 baromesh::AngleHistory{capacity}}
+    {}
+
+    virtual void onJointAngle (int joint, double degrees, int timestamp, int64_t hostTime) {
+        // Without a robot timestamp the sample cannot be placed in time.
+        if (joint < 0 || joint >= 3 || !timestamp) { return; }
+        std::lock_guard<std::mutex> lock{mutex};
+        joints[joint].push(timestamp, degrees);
+        sampleHostTime[joint] = hostTime;
+    }
+
+    virtual void onJointState (int joint, JointState::Type state, int, int64_t hostTime) {
+        if (joint < 0 || joint >= 3) { return; }
+        std::lock_guard<std::mutex> lock{mutex};
+        states[joint] = state;
+        stateHostTime[joint] = hostTime;
+    }
+
+    bool valid (int joint) const {
+        return joint >= 0 && joint < 3 && joints[joint].size();
+    }
+
+    Linkbot& linkbot;
+    mutable std::mutex mutex;
+    baromesh::AngleHistory joints[3];
+    int64_t sampleHostTime[3] = {};
+    JointState::Type states[3] = { JointState::MOVING, JointState::MOVING, JointState::MOVING };
+    int64_t stateHostTime[3] = {};
+};
+
+JointHistory::JointHistory (Linkbot& linkbot, size_t capacity, double encoderGranularity)
+    : m(new Impl(linkbot, capacity))
+{
+    try {
+        linkbot.addStateObserver(m, encoderGranularity);
+    }
+    catch (...) {
+        delete m;
+        throw;
+    }
+}
+
+JointHistory::~JointHistory () {
+    auto ec = boost::system::error_code{};
+    m->linkbot.removeStateObserver(m, ec);
+    delete m;
+}
+
+bool JointHistory::getLatestJointAngle (int joint, int& timestamp, double& degrees) const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    if (!m->valid(joint)) {
+        return false;
+    }
+    auto& s = m->joints[joint].newest();
+    timestamp = s.timestamp;
+    degrees = s.degrees;
+    return true;
+}
+
+bool JointHistory::getJointAngleAt (int joint, int timestamp, double& degrees) const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    return m->valid(joint) && m->joints[joint].angleAt(timestamp, degrees);
+}
+
+bool JointHistory::getJointVelocityEstimate (int joint, double& degreesPerSecond,
+                                             int windowMs) const {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    if (!m->valid(joint)) {
+        return false;
+    }
+    if (JointState::MOVING != m->states[joint]
+        && m->stateHostTime[joint] >= m->sampleHostTime[joint]) {
+        degreesPerSecond = 0;
+        return true;
+    }
+    return m->joints[joint].velocity(windowMs, degreesPerSecond);
+}
+
+void JointHistory::clear () {
+    std::lock_guard<std::mutex> lock{m->mutex};
+    for (auto& j : m->joints) {
+        j.clear();
+    }
+}
+
+} // namespace barobo
@@ -0,0 +1,128 @@
+#ifndef BAROMESH_JOINTMODEL_HPP
+#define BAROMESH_JOINTMODEL_HPP
+
+#include <baromesh/linkbot.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace baromesh {
+
+// Kinematics of one simulated joint: no mass, no load, just the motions the
+// firmware's controllers produce. Angles are in radians, time in seconds.
+struct JointModel {
+    using JointState = barobo::JointState::Type;
+
+    enum Motion { POSITION, VELOCITY, ACCELERATION };
+
+    static double radians (double degrees) { return degrees * 3.14159265358979323846 / 180.0; }
+
+    // Top speed of a Linkbot motor, roughly.
+    static double maxSpeed () { return radians(240); }
+
+    double angle = 0;
+    double velocity = 0;
+    double speed = radians(90);          // setJointSpeeds
+    double acceleration = radians(720);  // ramp used by smooth moves
+    JointState state = barobo::JointState::COAST;
+
+    // Drive to an absolute angle at the joint speed. A smooth move ramps its
+    // velocity up and down instead of starting and stopping dead.
+    void moveTo (double target, bool smooth = false) {
+        mMotion = POSITION;
+        mTarget = target;
+        mSmooth = smooth;
+        if (!smooth) {
+            velocity = 0;
+        }
+        start();
+    }
+
+    // Turn at a constant velocity until stopped. A velocity of zero is no
+    // motion at all: the joint stops in stillState.
+    void moveAt (double v, JointState stillState = barobo::JointState::COAST) {
+        if (0 == v) {
+            stop(stillState);
+            return;
+        }
+        mMotion = VELOCITY;
+        velocity = std::max(-maxSpeed(), std::min(maxSpeed(), v));
+        start();
+    }
+
+    // Accelerate at a constant rate, up to the motor's top speed.
+    void accelerate (double alpha) {
+        mMotion = ACCELERATION;
+        mAlpha = alpha;
+        start();
+    }
+
+    // After seconds, whatever the motion, settle into endState.
+    void setTimeout (double seconds, JointState endState) {
+        mTimeLeft = seconds;
+        mStateOnTimeout = endState;
+    }
+
+    void stop (JointState endState = barobo::JointState::COAST) {
+        velocity = 0;
+        state = endState;
+    }
+
+    // Advance by dt. Return true if the joint state changed.
+    bool step (double dt) {
+        if (barobo::JointState::MOVING != state) {
+            return false;
+        }
+        switch (mMotion) {
+            case POSITION: {
+                auto remaining = mTarget - angle;
+                auto direction = remaining < 0 ? -1.0 : 1.0;
+                auto v = speed;
+                if (mSmooth) {
+                    v = std::min(v, std::abs(velocity) + acceleration * dt);
+                    v = std::min(v, std::sqrt(2 * acceleration * std::abs(remaining)));
+                }
+                if (v * dt >= std::abs(remaining)) {
+                    angle = mTarget;
+                    stop(barobo::JointState::HOLD);
+                    return true;
+                }
+                velocity = direction * v;
+                angle += velocity * dt;
+                break;
+            }
+            case VELOCITY:
+                angle += velocity * dt;
+                break;
+            case ACCELERATION:
+                velocity = std::max(-maxSpeed(), std::min(maxSpeed(), velocity + mAlpha * dt));
+                angle += velocity * dt;
+                break;
+        }
+        if (mTimeLeft > 0) {
+            mTimeLeft -= dt;
+            if (mTimeLeft <= 0) {
+                stop(mStateOnTimeout);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    void start () {
+        state = barobo::JointState::MOVING;
+        mTimeLeft = 0;
+    }
+
+    Motion mMotion = POSITION;
+    double mTarget = 0;
+    bool mSmooth = false;
+    double mAlpha = 0;
+    double mTimeLeft = 0;
+    JointState mStateOnTimeout = barobo::JointState::HOLD;
+};
+
+} // namespace baromesh
+
+#endif
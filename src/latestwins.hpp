@@ -0,0 +1,131 @@
+#ifndef BAROMESH_LATESTWINS_HPP
+#define BAROMESH_LATESTWINS_HPP
+
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include <stdint.h>
+
+namespace baromesh {
+
+// Values for a setter which addresses joints through a bit mask. Coalescing
+// two of them keeps the newest value for each joint.
+struct JointValues {
+    int mask;
+    double values[3];
+};
+
+template <class T>
+void coalesce (T& pending, const T& newer) {
+    pending = newer;
+}
+
+inline void coalesce (JointValues& pending, const JointValues& newer) {
+    for (int i = 0; i < 3; ++i) {
+        if (newer.mask & (1 << i)) {
+            pending.values[i] = newer.values[i];
+        }
+    }
+    pending.mask |= newer.mask;
+}
+
+// Latest-value-wins slot for one setter. At most one request is in flight at
+// a time; values posted meanwhile are coalesced into a single pending value,
+// which is sent when the in-flight request completes.
+template <class Value>
+class LatestWins {
+public:
+    // Returns true if the caller must send value now. Otherwise the value has
+    // been merged into the pending one. ec receives the error, if any, from an
+    // earlier request through this slot.
+    bool post (const Value& value, boost::system::error_code& ec) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        ec = mError;
+        mError = boost::system::error_code{};
+        if (!mInFlight) {
+            mInFlight = true;
+            return true;
+        }
+        if (mHasPending) {
+            coalesce(mPending, value);
+            ++mSuperseded;
+        }
+        else {
+            mPending = value;
+            mHasPending = true;
+        }
+        return false;
+    }
+
+    // Report the outcome of the request in flight. Returns true if another
+    // value is pending, in which case it is moved to next and the caller must
+    // send it.
+    bool complete (boost::system::error_code ec, Value& next) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        if (ec) {
+            mError = ec;
+        }
+        return advance(next);
+    }
+
+    // Report that the request in flight was abandoned in favor of a command
+    // sent around this slot, such as a stop. Its failure is that command's
+    // doing, so it is not reported to later posts. Returns as complete()
+    // does.
+    bool abandon (Value& next) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        return advance(next);
+    }
+
+    // Take the joints in mask out of the pending value, so that it cannot
+    // undo a command sent around this slot. Only for JointValues slots.
+    void withdraw (int mask) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        if (mHasPending) {
+            mPending.mask &= ~mask;
+            mHasPending = 0 != mPending.mask;
+        }
+    }
+
+    // Block until nothing is in flight or pending.
+    void drain () {
+        std::unique_lock<std::mutex> lock{mMutex};
+        mIdle.wait(lock, [this] { return !mInFlight; });
+    }
+
+    // True if nothing is in flight or pending.
+    bool idle () const {
+        std::lock_guard<std::mutex> lock{mMutex};
+        return !mInFlight;
+    }
+
+    // Number of values which were replaced by a newer one before being sent.
+    uint64_t superseded () const { return mSuperseded; }
+
+private:
+    bool advance (Value& next) {
+        if (mHasPending) {
+            next = mPending;
+            mHasPending = false;
+            return true;
+        }
+        mInFlight = false;
+        mIdle.notify_all();
+        return false;
+    }
+
+    mutable std::mutex mMutex;
+    std::condition_variable mIdle;
+    bool mInFlight = false;
+    bool mHasPending = false;
+    Value mPending;
+    boost::system::error_code mError;
+    std::atomic<uint64_t> mSuperseded{0};
+};
+
+} // namespace baromesh
+
+#endif
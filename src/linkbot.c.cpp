@@ -1,10 +1,11 @@
 #include <baromesh/linkbot.h>
 #include <baromesh/linkbot.hpp>
 
-#include <iostream>
+#include <boost/system/error_code.hpp>
+
+#include <exception>
 #include <string>
 
-#include <cstdio>
 #include <cstring>
 
 namespace baromesh {
@@ -25,13 +26,53 @@ struct Linkbot {
 
 using namespace baromesh;
 
+namespace {
+
+// Details of the most recent failure on this thread. Recording an error_code
+// is just two word-sized stores; the message is only formatted if somebody
+// asks for it with linkbotLastError().
+struct LastError {
+    boost::system::error_code ec;
+    std::string what;
+};
+
+thread_local LastError lastError;
+
+int setLastError (const boost::system::error_code& ec) {
+    lastError.ec = ec;
+    lastError.what.clear();
+    return ec ? -1 : 0;
+}
+
+void setLastError (const std::exception& e) {
+    lastError.ec = make_error_code(boost::system::errc::io_error);
+    lastError.what = e.what();
+}
+
+} // file namespace
+
+const char* linkbotLastError()
+{
+    if (lastError.what.empty() && lastError.ec) {
+        lastError.what = lastError.ec.message();
+    }
+    return lastError.what.c_str();
+}
+
+int linkbotLastErrorCode()
+{
+    return lastError.ec.value();
+}
+
 Linkbot* linkbotFromTcpEndpoint(const char* host, const char* service)
 {
     try {
-        return new Linkbot(host, service);
+        auto l = new Linkbot(host, service);
+        setLastError(boost::system::error_code{});
+        return l;
     }
     catch (std::exception& e) {
-        fprintf(stderr, "Runtime exception: %s\n", e.what());
+        setLastError(e);
         return nullptr;
     }
 }
@@ -39,10 +80,12 @@ Linkbot* linkbotFromTcpEndpoint(const char* host, const char* service)
 Linkbot* linkbotFromSerialId(const char* serialId)
 {
     try {
-        return new Linkbot(serialId);
+        auto l = new Linkbot(serialId);
+        setLastError(boost::system::error_code{});
+        return l;
     }
     catch (std::exception& e) {
-        fprintf(stderr, "Runtime exception: %s\n", e.what());
+        setLastError(e);
         return nullptr;
     }
 }
@@ -56,16 +99,11 @@ void linkbotDelete(Linkbot* l)
 do \
 { \
     if (!l) { \
-        return -1; \
-    } \
-    try { \
-        l->impl. cpp_name (__VA_ARGS__); \
-        return 0; \
-    } \
-    catch (std::exception& e) { \
-        fprintf(stderr, "Runtime exception: %s\n", e.what()); \
-        return -1; \
+        return setLastError(make_error_code(boost::system::errc::bad_address)); \
     } \
+    auto ec = boost::system::error_code{}; \
+    l->impl. cpp_name (__VA_ARGS__, ec); \
+    return setLastError(ec); \
 } while(0)
 
 /* GETTERS */
@@ -118,19 +156,16 @@ int linkbotGetVersions (Linkbot* l, unsigned* major, unsigned* minor, unsigned*
 int linkbotGetSerialId(Linkbot* l, char* serialId)
 {
     if (!l) {
-        return -1;
+        return setLastError(make_error_code(boost::system::errc::bad_address));
     }
     std::string id;
-    try {
-        l->impl.getSerialId(id);
+    auto ec = boost::system::error_code{};
+    l->impl.getSerialId(id, ec);
+    if (!ec) {
         memcpy(serialId, id.c_str(), 4);
         serialId[4] = 0;
-        return 0;
-    }
-    catch (std::exception& e) {
-        fprintf(stderr, "Runtime exception: %s\n", e.what());
-        return -1;
     }
+    return setLastError(ec);
 }
 int linkbotGetJointSafetyThresholds(Linkbot* l, int* t1, int* t2, int* t3)
 {
@@ -156,7 +191,12 @@ int linkbotSetAlphaF(baromesh::Linkbot *l, int mask, double a1, double a2, doubl
 
 int linkbotResetEncoderRevs(Linkbot *l)
 {
-    LINKBOT_C_WRAPPER_FUNC_IMPL(resetEncoderRevs);
+    if (!l) {
+        return setLastError(make_error_code(boost::system::errc::bad_address));
+    }
+    auto ec = boost::system::error_code{};
+    l->impl.resetEncoderRevs(ec);
+    return setLastError(ec);
 }
 
 int linkbotSetBuzzerFrequency(Linkbot *l, float freq)
@@ -274,17 +314,7 @@ int linkbotStop(Linkbot *l, int mask) {
 #define SET_EVENT_CALLBACK(cbname) \
 int linkbotSet##cbname(Linkbot* l, barobo::cbname cb, void* userData) \
 { \
-    if (!l) { \
-        return -1; \
-    } \
-    try { \
-        l->impl.set##cbname(cb, userData); \
-        return 0; \
-    } \
-    catch (std::exception& e) { \
-        fprintf(stderr, "Runtime exception: %s\n", e.what()); \
-        return -1; \
-    } \
+    LINKBOT_C_WRAPPER_FUNC_IMPL(set##cbname, cb, userData); \
 }
 
 SET_EVENT_CALLBACK(ButtonEventCallback)
@@ -298,17 +328,7 @@ int linkbotSetEncoderEventCallback(Linkbot* l,
                                    float granularity,
                                    void* userData)
 {
-    if (!l) {
-        return -1;
-    }
-    try {
-        l->impl.setEncoderEventCallback(cb, granularity, userData);
-        return 0;
-    }
-    catch (std::exception& e) {
-        fprintf(stderr, "Runtime exception: %s\n", e.what());
-        return -1;
-    }
+    LINKBOT_C_WRAPPER_FUNC_IMPL(setEncoderEventCallback, cb, granularity, userData);
 }
 
 
@@ -1,4 +1,14 @@
+#include "clocksync.hpp"
 #include "daemon.hpp"
+#include "endpoint.hpp"
+#include "flowwindow.hpp"
+#include "iopool.hpp"
+#include "latestwins.hpp"
+#include "robotrpc.hpp"
+#include "shadowstate.hpp"
+#include "singleflight.hpp"
+#include "trace.hpp"
+#include "waiter.hpp"
 
 #include <baromesh/linkbot.hpp>
 #include <baromesh/error.hpp>
@@ -13,6 +23,8 @@
 
 #include <boost/asio/use_future.hpp>
 
+#include <boost/system/system_error.hpp>
+
 #include <boost/log/sources/logger.hpp>
 #include <boost/log/sources/record_ostream.hpp>
 
@@ -21,11 +33,22 @@
 #include <boost/algorithm/string/erase.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
 
+#include <boost/core/demangle.hpp>
+
 #include <boost/program_options/parsers.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
 
 namespace barobo {
 
@@ -35,46 +58,140 @@ std::chrono::milliseconds requestTimeout () {
     return std::chrono::milliseconds{1000};
 }
 
+// Where the robot keeps its four-character serial ID.
+const uint32_t kSerialIdAddress = 0x412;
+const size_t kSerialIdSize = 4;
+
+// Host steady-clock time in microseconds.
+int64_t hostNow () {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void throwIfError (const boost::system::error_code& ec) {
+    if (ec) {
+        throw Error(ec.message());
+    }
+}
+
+// An RPC method's name for traces: its type's name, unqualified.
+template <class Method>
+const char* methodName () {
+    static const std::string name = [] {
+        auto s = boost::core::demangle(typeid(Method).name());
+        auto colon = s.rfind("::");
+        return colon == std::string::npos ? s : s.substr(colon + 2);
+    }();
+    return name.c_str();
+}
+
+// Record a blocking call's phases on the calling thread: until the request
+// was sent or queued behind the flow-control window, until the I/O thread
+// decoded the reply, and until the caller woke up. replied is 0 if no reply
+// arrived.
+void traceCall (const char* name, int64_t called, int64_t queued, int64_t replied, int64_t woke) {
+    auto& tracer = baromesh::Tracer::global();
+    tracer.span(name, "call", called, woke);
+    tracer.span("queue", "call", called, queued);
+    if (replied) {
+        tracer.span("in flight", "call", queued, replied);
+        tracer.span("wake", "call", replied, woke);
+    }
+}
+
 } // file namespace
 
 using MethodIn = rpc::MethodIn<barobo::Robot>;
 using MethodResult = rpc::MethodResult<barobo::Robot>;
 using Broadcast = rpc::Broadcast<barobo::Robot>;
-using rpc::asio::asyncFire;
+using baromesh::IgnoredResult;
 
 using boost::asio::use_future;
 
+namespace {
+
+MethodIn::setLedColor ledColorArgs (const uint32_t& rgb) {
+    return MethodIn::setLedColor{rgb};
+}
+
+MethodIn::setBuzzerFrequency buzzerFrequencyArgs (const float& freq) {
+    return MethodIn::setBuzzerFrequency{freq};
+}
+
+MethodIn::setMotorControllerOmega jointSpeedsArgs (const baromesh::JointValues& speeds) {
+    MethodIn::setMotorControllerOmega arg;
+    arg.mask = speeds.mask;
+    arg.values_count = 0;
+    int jointFlag = 0x01;
+    for (auto& s : speeds.values) {
+        if (jointFlag & speeds.mask) {
+            arg.values[arg.values_count++] = float(baromesh::degToRad(s));
+        }
+        jointFlag <<= 1;
+    }
+    return arg;
+}
+
+MethodIn::move motorPowerArgs (const baromesh::JointValues& power) {
+    return MethodIn::move {
+        bool(power.mask&0x01), { barobo_Robot_Goal_Type_INFINITE,
+                                 float(power.values[0]),
+                                 true,
+                                 barobo_Robot_Goal_Controller_PID
+                               },
+        bool(power.mask&0x02), { barobo_Robot_Goal_Type_INFINITE,
+                                 float(power.values[1]),
+                                 true,
+                                 barobo_Robot_Goal_Controller_PID
+                               },
+        bool(power.mask&0x04), { barobo_Robot_Goal_Type_INFINITE,
+                                 float(power.values[2]),
+                                 true,
+                                 barobo_Robot_Goal_Controller_PID
+                               }
+    };
+}
+
+} // file namespace
+
+// How a request is scheduled. URGENT requests skip write coalescing and the
+// flow-control window. STOP requests do too, and also abandon any motion
+// commands still queued behind the window, since they would undo the stop.
+enum class Priority { NORMAL, URGENT, STOP };
+
+// Motion commands, which a STOP request supersedes.
+template <class Method>
+struct IsMotion : std::false_type {};
+
+template <>
+struct IsMotion<MethodIn::move> : std::true_type {};
+
 struct Linkbot::Impl {
+    struct Handle;
+
 private:
-    explicit Impl (const std::string& host, const std::string& service)
-        : io(util::asio::IoThread::getGlobal())
-        , wsConnector(io->context())
-        , robot(io->context())
+    // Connect to a robot proxy at endpoint; see endpoint.hpp.
+    explicit Impl (const std::string& endpoint)
+        : wsConnector(io.context())
+        , robot(io.context())
     {
-#if 0
-        auto uri = std::make_shared<websocketpp::uri>(false, host, service, "");
-        BOOST_LOG(log) << "Connecting to Linkbot proxy at " << uri->str();
-        connector.init_asio(&io->context());
-        auto ec = boost::system::error_code{};
-        auto con = connector.get_connection(uri, ec);
-        if (ec) { throw boost::system::system_error{ec}; }
-        auto openPromise = std::promise<void>{};
-        auto openFuture = openPromise.get_future();
-        con->set_open_handler([con, &openPromise](websocketpp::connection_hdl) {
-            openPromise.set_value();
-        });
-        con->set_fail_handler([con, &openPromise](websocketpp::connection_hdl) {
-            auto e = boost::system::system_error{con->get_transport_ec()};
-            openPromise.set_exception(std::make_exception_ptr(e));
-        });
-        connector.connect(con);
-        openFuture.get();
-        robot.messageQueue().setConnection(con);
-#endif
-        BOOST_LOG(log) << "Connecting to Linkbot proxy at " << host << ":" << service;
-        wsConnector.asyncConnect(robot.messageQueue(), host, service, use_future).get();
+        BOOST_LOG(log) << "Connecting to Linkbot proxy at " << endpoint;
+        baromesh::connectEndpoint(robot.messageQueue(), wsConnector, endpoint);
+        start();
+    }
+
+    void start () {
         rpc::asio::asyncConnect<barobo::Robot>(robot, requestTimeout(), use_future).get();
-        robotRunDone = rpc::asio::asyncRunClient<barobo::Robot>(robot, *this, use_future);
+        auto done = std::make_shared<std::promise<void>>();
+        robotRunDone = done->get_future();
+        rpc::asio::asyncRunClient<barobo::Robot>(robot, *this,
+            [this, done] (boost::system::error_code ec) {
+                BOOST_LOG(log) << "Robot connection ended: " << ec.message();
+                connected = false;
+                unpublish();
+                done->set_value();
+            });
+        prefetchIdentity();
     }
 
     static void initializeLoggingCore () {
@@ -102,60 +219,185 @@ private:
         });
     }
 
+    // Connections are shared by every Linkbot handle in the process which
+    // names the same robot. Each is registered under the keys it was opened
+    // by ("host:service", "serial:ABCD") and counts the handles using it.
+    struct Registry {
+        std::mutex mutex;
+        std::map<std::string, Impl*> connections;
+    };
+
+    static Registry& registry () {
+        static Registry r;
+        return r;
+    }
+
+    // Return the connection registered under key with a new reference to it,
+    // or nullptr.
+    static Impl* find (const std::string& key) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock{r.mutex};
+        auto it = r.connections.find(key);
+        if (it == r.connections.end() || !it->second->connected || !it->second->refs) {
+            return nullptr;
+        }
+        ++it->second->refs;
+        return it->second;
+    }
+
+    // Register impl under keys and return it with a new reference. If some
+    // other thread registered a connection under one of the keys while we
+    // were connecting, return that one instead, and let ours disconnect.
+    static Impl* publish (const std::vector<std::string>& keys, std::unique_ptr<Impl> impl) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock{r.mutex};
+        Impl* winner = nullptr;
+        for (auto& key : keys) {
+            auto it = r.connections.find(key);
+            if (it != r.connections.end() && it->second->connected) {
+                winner = it->second;
+                break;
+            }
+        }
+        if (!winner) {
+            winner = impl.release();
+        }
+        for (auto& key : keys) {
+            auto it = r.connections.find(key);
+            if (it != r.connections.end() && !it->second->connected) {
+                // A dead connection which its handles have not released yet.
+                auto& stale = it->second->keys;
+                stale.erase(std::remove(stale.begin(), stale.end(), key), stale.end());
+                r.connections.erase(it);
+            }
+            if (r.connections.emplace(key, winner).second) {
+                winner->keys.push_back(key);
+            }
+        }
+        ++winner->refs;
+        return winner;
+    }
+
+    // Take this connection out of the registry once it is dead, so that the
+    // next Linkbot opened for the robot connects afresh. Handles which already
+    // hold it keep it until they are destroyed.
+    void unpublish () {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock{r.mutex};
+        unpublishLocked(r);
+    }
+
+    // unpublish() with registry().mutex already held.
+    void unpublishLocked (Registry& r) {
+        for (auto& key : keys) {
+            auto it = r.connections.find(key);
+            if (it != r.connections.end() && this == it->second) {
+                r.connections.erase(it);
+            }
+        }
+        keys.clear();
+    }
+
+    // Also register impl, which the caller holds a reference to, under key.
+    static void alias (const std::string& key, Impl* impl) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock{r.mutex};
+        if (r.connections.emplace(key, impl).second) {
+            impl->keys.push_back(key);
+        }
+    }
+
 public:
     static Impl* fromWebSocketEndpoint (const std::string& host, const std::string& service) {
         initializeLoggingCore();
-        return new Impl{host, service};
+        auto key = host + ":" + service;
+        if (auto impl = find(key)) {
+            return impl;
+        }
+        return publish({key}, std::unique_ptr<Impl>{new Impl{key}});
     }
 
-    // Use the daemon to resolve a serial ID to WebSocket URI and
-    // construct a Linkbot::Impl backed by this host:service. The caller has
-    // ownership of the returned pointer.
+    // Use the daemon to resolve a serial ID to WebSocket URI and return the
+    // Linkbot::Impl backed by this host:service, constructing it if no other
+    // handle has it open. Release the returned pointer with release().
     static Impl* fromSerialId (const std::string& serialId) {
         initializeLoggingCore();
-        auto io = util::asio::IoThread::getGlobal();
-        boost::log::sources::logger log;
-        baromesh::WebSocketClient daemon {io->context()};
-
-#if 0
-        auto daemonUri = std::make_shared<websocketpp::uri>(
-            false, baromesh::daemonHostName(), baromesh::daemonServiceName(), "");
-        BOOST_LOG(log) << "Connecting to the daemon at " << daemonUri->str();
-        websocketpp::client<websocketpp::config::asio_client> dConnector;  // transport creator
-        dConnector.init_asio(&io->context());
-        auto ec = boost::system::error_code{};
-        auto con = dConnector.get_connection(daemonUri, ec);
-        if (ec) { throw boost::system::system_error{ec}; }
-        auto openPromise = std::promise<void>{};
-        auto openFuture = openPromise.get_future();
-        con->set_open_handler([con, &openPromise](websocketpp::connection_hdl) {
-            openPromise.set_value();
-        });
-        con->set_fail_handler([con, &openPromise](websocketpp::connection_hdl) {
-            auto e = boost::system::system_error{con->get_transport_ec()};
-            openPromise.set_exception(std::make_exception_ptr(e));
-        });
-        dConnector.connect(con);
-        openFuture.get();
-        daemon.messageQueue().setConnection(con);
-#endif
-        baromesh::websocket::Connector dConnector{io->context()};
-        dConnector.asyncConnect(daemon.messageQueue(),
-            baromesh::daemonHostName(), baromesh::daemonServiceName(), use_future).get();
-        rpc::asio::asyncConnect<barobo::Daemon>(daemon, requestTimeout(), use_future).get();
+        auto serialKey = "serial:" + boost::to_upper_copy(serialId);
+        if (auto impl = find(serialKey)) {
+            return impl;
+        }
+        baromesh::IoLease io;
+        auto key = baromesh::robotEndpoint(baromesh::resolveSerialId(io.context(),
+            serialId, requestTimeout()));
+        if (auto impl = find(key)) {
+            alias(serialKey, impl);
+            return impl;
+        }
+        return publish({serialKey, key}, std::unique_ptr<Impl>{new Impl{key}});
+    }
 
-        std::string host, service;
-        std::tie(host, service) = baromesh::asyncResolveSerialId(daemon,
-            serialId, requestTimeout(), use_future).get();
+    // Attach to the baromesh-broker which owns the robot's connection.
+    static Impl* fromBroker (const std::string& serialId) {
+        initializeLoggingCore();
+        auto key = "broker:" + boost::to_upper_copy(serialId);
+        if (auto impl = find(key)) {
+            return impl;
+        }
+        auto directory = baromesh::brokerSocketDirectory();
+        if (!baromesh::isPrivateDirectory(directory)) {
+            throw barobo::Error(directory + " is not a private directory of this user; "
+                "refusing to trust a broker socket in it");
+        }
+        auto endpoint = "unix:" + baromesh::brokerSocketPath(serialId);
+        return publish({key}, std::unique_ptr<Impl>{new Impl{endpoint}});
+    }
 
-        BOOST_LOG(log) << "Disconnecting daemon client";
-        asyncDisconnect(daemon, requestTimeout(), use_future).get();
-        daemon.close();
+    // Connect straight to a robot proxy listening on a Unix-domain socket or
+    // in this process.
+    static Impl* fromLocalEndpoint (const std::string& endpoint) {
+        initializeLoggingCore();
+        if (auto impl = find(endpoint)) {
+            return impl;
+        }
+        return publish({endpoint}, std::unique_ptr<Impl>{new Impl{endpoint}});
+    }
 
-        return new Impl{host, service};
+    // "broker:ABCD" names a robot shared through baromesh-broker,
+    // "unix:/path" a robot proxy's socket, "inproc://name" a robot
+    // implementation in this process, anything else a serial ID.
+    static Impl* fromString (const std::string& id) {
+        const auto brokerPrefix = std::string{"broker:"};
+        if (boost::starts_with(id, brokerPrefix)) {
+            return fromBroker(id.substr(brokerPrefix.size()));
+        }
+        if (baromesh::isUnixEndpoint(id) || baromesh::isInprocEndpoint(id)) {
+            return fromLocalEndpoint(id);
+        }
+        return fromSerialId(id);
+    }
+
+    // Every Linkbot handle releases its connection on destruction. The last
+    // release disconnects. It takes the connection out of the registry under
+    // the same lock as the final decrement, so no find() can revive it while
+    // it is being deleted.
+    static void release (Impl* impl, const Linkbot* owner) {
+        impl->detach(owner);
+        auto last = false;
+        {
+            auto& r = registry();
+            std::lock_guard<std::mutex> lock{r.mutex};
+            last = 0 == --impl->refs;
+            if (last) {
+                impl->unpublishLocked(r);
+            }
+        }
+        if (last) {
+            delete impl;
+        }
     }
 
     ~Impl () {
+        drainWrites();
         if (robotRunDone.valid()) {
             try {
                 BOOST_LOG(log) << "Disconnecting robot client";
@@ -169,30 +411,644 @@ public:
         }
     }
 
-    void onBroadcast (Broadcast::buttonEvent b) {
-        if (buttonEventCallback) {
-            buttonEventCallback(static_cast<Button::Type>(b.button),
-                                static_cast<ButtonState::Type>(b.state),
-                                b.timestamp);
+    // The context of a request, at the head of every context a RobotHandler
+    // points to. Whoever fires the request owns it and keeps it alive until
+    // the handler has run; the handler must settle() it first.
+    struct Pending {
+        Impl* impl = nullptr;
+        int64_t sent = 0;  // 0 until the request is handed to the RPC client
+    };
+
+    // Fire a request through the flow-control window. A request which fits
+    // in the window is handed to the RPC client on the calling thread without
+    // allocating; one which does not is copied into the window's queue and
+    // started as earlier requests complete. handler is called exactly once,
+    // on the calling thread if the request cannot be sent at all.
+    //
+    // Urgent requests skip the queue and the window, and the time from the
+    // call to their handoff is recorded as their dispatch latency. Queued
+    // motion commands abandoned by a STOP request fail with
+    // operation_canceled.
+    template <class Result, class Method>
+    void fire (const Method& args, Pending& pending, baromesh::RobotHandler<Result> handler,
+               Priority priority = Priority::NORMAL) {
+        pending.impl = this;
+        pending.sent = 0;
+        switch (priority) {
+            case Priority::STOP:
+                flow.cancelQueued();
+                // fall through
+            case Priority::URGENT:
+                flow.acquireUrgent();
+                dispatch(args, pending, handler, hostNow());
+                break;
+            case Priority::NORMAL:
+                if (flow.tryAcquire()) {
+                    dispatch(args, pending, handler, 0);
+                    break;
+                }
+                try {
+                    flow.submit(new Queued<Result, Method>{*this, args, pending, handler});
+                }
+                catch (std::bad_alloc&) {
+                    handler(make_error_code(boost::system::errc::not_enough_memory), Result{});
+                }
+                break;
         }
     }
 
-    void onBroadcast (Broadcast::encoderEvent b) {
-        if (encoderEventCallback) {
-            encoderEventCallback(b.encoder, baromesh::radToDeg(b.value), b.timestamp);
+    // A request waiting in the flow-control window's queue.
+    template <class Result, class Method>
+    struct Queued : baromesh::FlowWindow::Request {
+        Queued (Impl& i, const Method& a, Pending& p, baromesh::RobotHandler<Result> h)
+            : impl(i), args(a), pending(p), handler(h)
+        {}
+
+        virtual void start () override {
+            impl.dispatch(args, pending, handler, 0);
+        }
+
+        virtual bool cancellable () const override {
+            return IsMotion<Method>::value;
+        }
+
+        virtual void abort () override {
+            handler(make_error_code(boost::system::errc::operation_canceled), Result{});
+        }
+
+        Impl& impl;
+        Method args;
+        Pending& pending;
+        baromesh::RobotHandler<Result> handler;
+    };
+
+    // Hand a request which holds room in the window to the RPC client. called
+    // is when an urgent request was made, otherwise 0.
+    template <class Result, class Method>
+    void dispatch (const Method& args, Pending& pending, baromesh::RobotHandler<Result> handler,
+                   int64_t called) {
+        pending.sent = hostNow();
+        try {
+            baromesh::asyncFireRobot<Result>(robot, args, requestTimeout(), handler);
+            if (called) {
+                recordDispatch(methodName<Method>(), called, hostNow());
+            }
+        }
+        catch (boost::system::system_error& e) {
+            handler(e.code(), Result{});
+        }
+        catch (std::exception& e) {
+            BOOST_LOG(log) << "Exception firing RPC: " << e.what();
+            handler(make_error_code(boost::system::errc::io_error), Result{});
         }
     }
 
-    void onBroadcast (Broadcast::accelerometerEvent b) {
-        if (accelerometerEventCallback) {
-            accelerometerEventCallback(b.x, b.y, b.z, b.timestamp);
+    // Tell the window how a finished request's round trip went. A timeout
+    // counts as a loss; other failures say nothing about congestion. A request
+    // abandoned before it was sent never held room in the window.
+    void settle (Pending& pending, boost::system::error_code ec) {
+        if (!pending.sent) {
+            return;
         }
+        auto roundTrip = hostNow() - pending.sent;
+        auto lost = ec && std::chrono::microseconds{roundTrip} >= requestTimeout();
+        flow.complete(ec && !lost ? 0 : roundTrip, lost);
     }
 
-    void onBroadcast (Broadcast::jointEvent b) {
-        if (jointEventCallback) {
-            jointEventCallback(b.joint, static_cast<JointState::Type>(b.event), b.timestamp);
+    void recordDispatch (const char* name, int64_t called, int64_t dispatched) {
+        auto latency = dispatched - called;
+        lastDispatchLatency = latency;
+        auto max = maxDispatchLatency.load();
+        while (latency > max && !maxDispatchLatency.compare_exchange_weak(max, latency)) {
+        }
+        baromesh::Tracer::global().span(name, "dispatch", called, dispatched);
+    }
+
+    // A blocking caller's request: the reply is stored through result,
+    // status and, if given, replied, and then waiter is notified.
+    struct Reply : Pending {
+        baromesh::Waiter* waiter;
+        void* result;
+        boost::system::error_code* status;
+        int64_t* replied;
+    };
+
+    template <class Result>
+    static void onReply (void* context, boost::system::error_code ec, const Result& r) {
+        auto& reply = *static_cast<Reply*>(context);
+        reply.impl->settle(reply, ec);
+        if (reply.replied) {
+            *reply.replied = hostNow();
+        }
+        if (!ec) {
+            *static_cast<Result*>(reply.result) = r;
+        }
+        *reply.status = ec;
+        // The caller may return, and reply go away, as soon as this is done.
+        reply.waiter->notify();
+    }
+
+    template <class Result>
+    static baromesh::RobotHandler<Result> replyHandler (Reply& reply, Result&) {
+        return baromesh::RobotHandler<Result>{&onReply<Result>, &reply};
+    }
+
+    // Fire an RPC and block until its result arrives or the request times out.
+    // Failure is reported through ec; nothing is thrown.
+    template <class Method, class Result>
+    void call (const Method& args, Result& result, boost::system::error_code& ec,
+               Priority priority = Priority::NORMAL) BOOST_NOEXCEPT {
+        auto traced = baromesh::Tracer::global().enabled();
+        auto called = traced ? hostNow() : 0;
+        auto replied = int64_t{};
+        auto& waiter = baromesh::Waiter::local();
+        auto status = boost::system::error_code{};
+        Reply reply;
+        reply.waiter = &waiter;
+        reply.result = &result;
+        reply.status = &status;
+        reply.replied = traced ? &replied : nullptr;
+        waiter.arm();
+        fire(args, reply, replyHandler(reply, result), priority);
+        auto queued = traced ? hostNow() : 0;
+        waiter.wait(baromesh::IoPool::global().spinBudget());
+        ec = status;
+        if (traced) {
+            traceCall(methodName<Method>(), called, queued, replied, hostNow());
+        }
+        if (ec) {
+            invalidateShadows();
+        }
+    }
+
+    // Several requests in flight at once. fire() each of them, then wait() for
+    // all of the replies; ec receives the first failure.
+    class Batch {
+    public:
+        static const int kMaxRequests = 8;
+
+        Batch (Impl& impl, int n)
+            : mImpl(impl)
+            , mWaiter(baromesh::Waiter::local())
+            , mCount(0)
+            , mBegin(baromesh::Tracer::global().enabled() ? hostNow() : 0)
+        {
+            assert(n <= kMaxRequests);
+            mWaiter.arm(n);
+        }
+
+        template <class Method, class Result>
+        void fire (const Method& args, Result& result, int64_t& hostTime) BOOST_NOEXCEPT {
+            if (mBegin) {
+                mNames[mCount] = methodName<Method>();
+                mFired[mCount] = hostNow();
+                mReplied[mCount] = &hostTime;
+            }
+            auto& reply = mReplies[mCount];
+            reply.waiter = &mWaiter;
+            reply.result = &result;
+            reply.status = &mStatus[mCount];
+            reply.replied = &hostTime;
+            ++mCount;
+            mImpl.fire(args, reply, replyHandler(reply, result));
+        }
+
+        void wait (boost::system::error_code& ec) {
+            auto queued = mBegin ? hostNow() : 0;
+            mWaiter.wait(baromesh::IoPool::global().spinBudget());
+            if (mBegin) {
+                auto& tracer = baromesh::Tracer::global();
+                tracer.span("batch", "call", mBegin, hostNow());
+                tracer.span("queue", "call", mBegin, queued);
+                for (int i = 0; i < mCount; ++i) {
+                    if (!mStatus[i]) {
+                        tracer.span(mNames[i], "call", mFired[i], *mReplied[i]);
+                    }
+                }
+            }
+            ec = boost::system::error_code{};
+            for (int i = 0; i < mCount && !ec; ++i) {
+                ec = mStatus[i];
+            }
+            if (ec) {
+                mImpl.invalidateShadows();
+            }
+        }
+
+    private:
+        Impl& mImpl;
+        baromesh::Waiter& mWaiter;
+        int mCount;
+        boost::system::error_code mStatus[kMaxRequests];
+        Reply mReplies[kMaxRequests];
+
+        // Tracing, if mBegin is nonzero.
+        int64_t mBegin;
+        const char* mNames[kMaxRequests];
+        int64_t mFired[kMaxRequests];
+        int64_t* mReplied[kMaxRequests];
+    };
+
+    // The leader's request for callCoalesced(): its reply completes flight.
+    template <class Result>
+    struct FlightReply : Pending {
+        baromesh::SingleFlight<Result>* flight;
+        int64_t* replied;
+    };
+
+    template <class Result>
+    static void onFlightReply (void* context, boost::system::error_code ec, const Result& r) {
+        auto& reply = *static_cast<FlightReply<Result>*>(context);
+        reply.impl->settle(reply, ec);
+        if (reply.replied) {
+            *reply.replied = hostNow();
+        }
+        reply.flight->complete(ec, r, reply.sent);
+    }
+
+    // Like call(), but if an identical request is already in flight, wait for
+    // its reply instead of sending another one. Only use this for sensor reads,
+    // where a reply to a request sent slightly before the call is as good as
+    // a fresh one. Returns true if this call sent the request. sent, if given,
+    // receives the host time at which the request was sent, whichever caller
+    // sent it; 0 if it never was.
+    template <class Method, class Result>
+    bool callCoalesced (baromesh::SingleFlight<Result>& flight, const Method& args,
+                        Result& result, boost::system::error_code& ec,
+                        int64_t* sent = nullptr) BOOST_NOEXCEPT {
+        auto traced = baromesh::Tracer::global().enabled();
+        auto called = traced ? hostNow() : 0;
+        auto replied = int64_t{};
+        auto& waiter = baromesh::Waiter::local();
+        auto status = boost::system::error_code{};
+        waiter.arm();
+        auto leader = flight.join({&waiter, &result, &status, sent});
+        FlightReply<Result> reply;
+        if (leader) {
+            reply.flight = &flight;
+            reply.replied = traced ? &replied : nullptr;
+            fire(args, reply, baromesh::RobotHandler<Result>{&onFlightReply<Result>, &reply});
+        }
+        auto queued = traced ? hostNow() : 0;
+        waiter.wait(baromesh::IoPool::global().spinBudget());
+        ec = status;
+        if (traced) {
+            // A follower only waited on the leader's request.
+            traceCall(methodName<Method>(), called, queued, leader ? replied : 0, hostNow());
+        }
+        if (ec) {
+            invalidateShadows();
+        }
+        return leader;
+    }
+
+    // One latest-value-wins setter: its slot, the shadow which acknowledged
+    // values update, if any, and the context of its request in flight, of
+    // which the slot allows at most one.
+    template <class Value, class Method>
+    struct CoalescedWrite : Pending {
+        CoalescedWrite (baromesh::Shadow<Value>* s, Method (*m)(const Value&))
+            : shadow(s), makeArgs(m)
+        {}
+
+        baromesh::LatestWins<Value> slot;
+        baromesh::Shadow<Value>* shadow;
+        Method (*makeArgs)(const Value&);
+        Value value;  // in flight
+    };
+
+    // Latest-value-wins write: send value now if nothing is in flight through
+    // the slot, otherwise leave it to be sent when the in-flight request
+    // completes. Never blocks; ec reports an earlier failure through the
+    // slot. The shadow, if any, is updated when the robot acknowledges a
+    // value.
+    template <class Value, class Method>
+    void post (CoalescedWrite<Value, Method>& write, const Value& value,
+               boost::system::error_code& ec) BOOST_NOEXCEPT {
+        if (write.shadow && write.slot.idle() && elide(*write.shadow, value)) {
+            ec = boost::system::error_code{};
+            return;
+        }
+        if (write.slot.post(value, ec)) {
+            send(write, value);
+        }
+    }
+
+    template <class Value, class Method>
+    void send (CoalescedWrite<Value, Method>& write, const Value& value) BOOST_NOEXCEPT {
+        write.value = value;
+        fire(write.makeArgs(value), write,
+             baromesh::RobotHandler<IgnoredResult>{&onWritten<Value, Method>, &write});
+    }
+
+    template <class Value, class Method>
+    static void onWritten (void* context, boost::system::error_code ec, const IgnoredResult&) {
+        auto& write = *static_cast<CoalescedWrite<Value, Method>*>(context);
+        auto& impl = *write.impl;
+        impl.settle(write, ec);
+        if (ec) {
+            impl.invalidateShadows();
+        }
+        else if (write.shadow) {
+            write.shadow->update(write.value);
+        }
+        // A write which a stop took out of the queue failed on the stop's
+        // account; its caller has long returned, and the next one must not
+        // be handed the stop's cancellation.
+        auto abandoned = ec == make_error_code(boost::system::errc::operation_canceled);
+        auto next = Value{};
+        if (abandoned ? write.slot.abandon(next) : write.slot.complete(ec, next)) {
+            impl.send(write, next);
+        }
+    }
+
+    // True if shadow-state elision is on and writing value would not change
+    // the robot's last acknowledged setting.
+    template <class Value>
+    bool elide (const baromesh::Shadow<Value>& shadow, const Value& value) const {
+        return shadowState && shadow.covers(value);
+    }
+
+    // Forget everything we think we know about the robot's configuration.
+    // Called on any error and when the connection is lost, since we can no
+    // longer be sure what the robot actually applied.
+    void invalidateShadows () {
+        ledColorShadow.invalidate();
+        jointSpeedsShadow.invalidate();
+        safetyThresholdsShadow.invalidate();
+        safetyAnglesShadow.invalidate();
+    }
+
+    void drainWrites () {
+        ledColorWrites.slot.drain();
+        buzzerFrequencyWrites.slot.drain();
+        jointSpeedsWrites.slot.drain();
+        motorPowerWrites.slot.drain();
+    }
+
+    template <class Method>
+    void call (const Method& args, boost::system::error_code& ec,
+               Priority priority = Priority::NORMAL) BOOST_NOEXCEPT {
+        auto result = IgnoredResult{};
+        call(args, result, ec, priority);
+    }
+
+    // Fetch the properties which cannot change while connected, pipelined in
+    // one round trip. Failure is not fatal: the getters fetch whatever is
+    // missing on first use.
+    void prefetchIdentity () {
+        auto serialArgs = MethodIn::readEeprom{};
+        serialArgs.address = kSerialIdAddress;
+        serialArgs.size = kSerialIdSize;
+        MethodResult::readEeprom serial;
+        MethodResult::getFormFactor form;
+        MethodResult::getFirmwareVersion version;
+        int64_t replied[3];
+        auto ec = boost::system::error_code{};
+        Batch batch{*this, 3};
+        batch.fire(serialArgs, serial, replied[0]);
+        batch.fire(MethodIn::getFormFactor{}, form, replied[1]);
+        batch.fire(MethodIn::getFirmwareVersion{}, version, replied[2]);
+        batch.wait(ec);
+        if (ec) {
+            BOOST_LOG(log) << "Could not prefetch robot properties: " << ec.message();
+            return;
+        }
+        char id[kSerialIdSize + 1] = {};
+        memcpy(id, serial.data.bytes, std::min(size_t(serial.data.size), kSerialIdSize));
+        cacheSerialId(id);
+        cacheFormFactor(FormFactor::Type(form.value));
+        cacheVersions(version.major, version.minor, version.patch);
+    }
+
+    void cacheSerialId (const char* id) {
+        std::lock_guard<std::mutex> lock{identityMutex};
+        memcpy(identity.serialId, id, sizeof(identity.serialId));
+        identity.hasSerialId = true;
+    }
+
+    void cacheFormFactor (FormFactor::Type form) {
+        std::lock_guard<std::mutex> lock{identityMutex};
+        identity.formFactor = form;
+        identity.hasFormFactor = true;
+    }
+
+    void cacheVersions (uint32_t major, uint32_t minor, uint32_t patch) {
+        BOOST_LOG(log) << "Firmware version " << major << '.' << minor << '.' << patch;
+        std::lock_guard<std::mutex> lock{identityMutex};
+        identity.versions[0] = major;
+        identity.versions[1] = minor;
+        identity.versions[2] = patch;
+        identity.hasVersions = true;
+    }
+
+    // Refine the clock estimate with a request sent at host time send and
+    // answered with robot time robot at host time receive.
+    void addClockSample (int64_t send, int64_t receive, int robot) {
+        std::lock_guard<std::mutex> lock{clockMutex};
+        clock.add(send, receive, robot);
+    }
+
+    // The robot time at which a request sent at send and answered at receive
+    // was most likely served, or 0 without an estimate.
+    int robotTimeOf (int64_t send, int64_t receive) const {
+        std::lock_guard<std::mutex> lock{clockMutex};
+        return clock.valid() ? clock.toRobot((send + receive) / 2) : 0;
+    }
+
+    template <class Notify>
+    void notifyObservers (Notify&& notify) {
+        std::lock_guard<std::mutex> lock{observersMutex};
+        for (auto observer : observers) {
+            notify(*observer);
+        }
+    }
+
+    bool hasObservers () {
+        std::lock_guard<std::mutex> lock{observersMutex};
+        return !observers.empty();
+    }
+
+    // Call f on every handle's callback table. f runs on a snapshot, without
+    // handlesMutex held, so a user callback may set callbacks or destroy a
+    // Linkbot sharing this connection.
+    template <class F>
+    void forEachHandle (F&& f) {
+        auto snapshot = std::shared_ptr<const Handles>{};
+        {
+            std::lock_guard<std::mutex> lock{handlesMutex};
+            snapshot = handlesSnapshot;
         }
+        for (auto& h : *snapshot) {
+            f(h.second);
+        }
+    }
+
+    // Republish handles for forEachHandle. Call with handlesMutex held after
+    // every change to handles.
+    void publishHandles () {
+        handlesSnapshot = std::make_shared<const Handles>(handles);
+    }
+
+    // The robot's event subscriptions are the union of what every handle's
+    // callbacks and the state observers need. These recompute that union
+    // and (re)send it to the robot.
+    void syncButtonEvents (boost::system::error_code& ec) {
+        auto enable = false;
+        forEachHandle([&] (const Handle& h) {
+            enable = enable || h.buttonEventCallback;
+        });
+        call(MethodIn::enableButtonEvent{enable}, ec);
+    }
+
+    void syncEncoderEvents (boost::system::error_code& ec) {
+        auto enable = hasObservers();
+        auto granularity = enable ? observerGranularity.load() : 0.0;
+        forEachHandle([&] (const Handle& h) {
+            if (h.encoderEventCallback) {
+                granularity = enable ? std::min(granularity, h.encoderCallbackGranularity)
+                                     : h.encoderCallbackGranularity;
+                enable = true;
+            }
+        });
+        auto radians = float(baromesh::degToRad(granularity));
+        call(MethodIn::enableEncoderEvent {
+            true, { enable, radians },
+            true, { enable, radians },
+            true, { enable, radians }
+        }, ec);
+    }
+
+    void syncJointEvents (boost::system::error_code& ec) {
+        auto enable = hasObservers();
+        forEachHandle([&] (const Handle& h) {
+            enable = enable || h.jointEventCallback;
+        });
+        call(MethodIn::enableJointEvent{enable}, ec);
+    }
+
+    void syncAccelerometerEvents (boost::system::error_code& ec) {
+        auto enable = hasObservers();
+        forEachHandle([&] (const Handle& h) {
+            enable = enable || h.accelerometerEventCallback;
+        });
+        auto granularity = float(enable ? 0.05 : 0);
+        call(MethodIn::enableAccelerometerEvent {
+            enable, granularity
+        }, ec);
+    }
+
+    void syncObserverEvents (boost::system::error_code& ec) {
+        syncEncoderEvents(ec);
+        if (!ec) {
+            syncJointEvents(ec);
+        }
+        if (!ec) {
+            syncAccelerometerEvents(ec);
+        }
+    }
+
+    // Install callback in owner's table, then resubscribe. On failure, put the
+    // old callback back so the table still matches the robot.
+    template <class Callback>
+    void setCallback (const Linkbot* owner, Callback Handle::*member, Callback callback,
+                      void (Impl::*sync)(boost::system::error_code&),
+                      boost::system::error_code& ec) BOOST_NOEXCEPT {
+        try {
+            {
+                std::lock_guard<std::mutex> lock{handlesMutex};
+                std::swap(handles[owner].*member, callback);
+                publishHandles();
+            }
+            (this->*sync)(ec);
+            if (ec) {
+                std::lock_guard<std::mutex> lock{handlesMutex};
+                std::swap(handles[owner].*member, callback);
+                publishHandles();
+            }
+        }
+        catch (std::bad_alloc&) {
+            ec = make_error_code(boost::system::errc::not_enough_memory);
+        }
+    }
+
+    // Drop owner's callbacks. If other handles remain, shrink the robot's
+    // subscriptions to what they still need.
+    void detach (const Linkbot* owner) {
+        auto hadCallbacks = false;
+        auto others = false;
+        {
+            std::lock_guard<std::mutex> lock{handlesMutex};
+            auto it = handles.find(owner);
+            if (it != handles.end()) {
+                auto& h = it->second;
+                hadCallbacks = h.buttonEventCallback || h.encoderEventCallback
+                            || h.jointEventCallback || h.accelerometerEventCallback;
+                handles.erase(it);
+                publishHandles();
+            }
+            others = !handles.empty();
+        }
+        if (hadCallbacks && others) {
+            auto ec = boost::system::error_code{};
+            syncButtonEvents(ec);
+            syncObserverEvents(ec);
+            if (ec) {
+                BOOST_LOG(log) << "Error resubscribing events: " << ec.message();
+            }
+        }
+    }
+
+    void onBroadcast (Broadcast::buttonEvent b) {
+        baromesh::TraceScope trace{"buttonEvent", "broadcast"};
+        auto button = static_cast<Button::Type>(b.button);
+        auto state = static_cast<ButtonState::Type>(b.state);
+        forEachHandle([&] (const Handle& h) {
+            if (h.buttonEventCallback) {
+                h.buttonEventCallback(button, state, b.timestamp);
+            }
+        });
+    }
+
+    void onBroadcast (Broadcast::encoderEvent b) {
+        baromesh::TraceScope trace{"encoderEvent", "broadcast"};
+        auto hostTime = hostNow();
+        auto degrees = baromesh::radToDeg(b.value);
+        notifyObservers([&] (StateObserver& o) {
+            o.onJointAngle(b.encoder, degrees, b.timestamp, hostTime);
+        });
+        forEachHandle([&] (const Handle& h) {
+            if (h.encoderEventCallback) {
+                h.encoderEventCallback(b.encoder, degrees, b.timestamp);
+            }
+        });
+    }
+
+    void onBroadcast (Broadcast::accelerometerEvent b) {
+        baromesh::TraceScope trace{"accelerometerEvent", "broadcast"};
+        auto hostTime = hostNow();
+        notifyObservers([&] (StateObserver& o) {
+            o.onAccelerometer(b.x, b.y, b.z, b.timestamp, hostTime);
+        });
+        forEachHandle([&] (const Handle& h) {
+            if (h.accelerometerEventCallback) {
+                h.accelerometerEventCallback(b.x, b.y, b.z, b.timestamp);
+            }
+        });
+    }
+
+    void onBroadcast (Broadcast::jointEvent b) {
+        baromesh::TraceScope trace{"jointEvent", "broadcast"};
+        auto hostTime = hostNow();
+        auto state = static_cast<JointState::Type>(b.event);
+        notifyObservers([&] (StateObserver& o) {
+            o.onJointState(b.joint, state, b.timestamp, hostTime);
+        });
+        forEachHandle([&] (const Handle& h) {
+            if (h.jointEventCallback) {
+                h.jointEventCallback(b.joint, state, b.timestamp);
+            }
+        });
     }
 
     void onBroadcast (Broadcast::debugMessageEvent e) {
@@ -200,24 +1056,97 @@ public:
     }
 
     void onBroadcast (Broadcast::connectionTerminated b) {
+        baromesh::TraceScope trace{"connectionTerminated", "broadcast"};
         BOOST_LOG(log) << "Connection terminated at " << b.timestamp;
-        if (connectionTerminatedCallback) {
-            connectionTerminatedCallback(b.timestamp);
+        connected = false;
+        unpublish();
+        invalidateShadows();
+        {
+            // Whatever robot answers next may be running a different clock.
+            std::lock_guard<std::mutex> lock{clockMutex};
+            clock.clear();
+        }
+        {
+            // Or be a different robot altogether.
+            std::lock_guard<std::mutex> lock{identityMutex};
+            identity = Identity{};
         }
+        forEachHandle([&] (const Handle& h) {
+            if (h.connectionTerminatedCallback) {
+                h.connectionTerminatedCallback(b.timestamp);
+            }
+        });
     }
     mutable boost::log::sources::logger log;
 
-    std::shared_ptr<util::asio::IoThread> io;
+    baromesh::IoLease io;
     baromesh::websocket::Connector wsConnector;
 
     baromesh::WebSocketClient robot;  // RPC client
     std::future<void> robotRunDone;
 
-    std::function<void(Button::Type, ButtonState::Type, int)> buttonEventCallback;
-    std::function<void(int,double, int)> encoderEventCallback;
-    std::function<void(int,JointState::Type, int)> jointEventCallback;
-    std::function<void(double,double,double,int)> accelerometerEventCallback;
-    std::function<void(int)> connectionTerminatedCallback;
+    baromesh::FlowWindow flow;
+    std::atomic<int64_t> lastDispatchLatency{0};  // microseconds
+    std::atomic<int64_t> maxDispatchLatency{0};
+
+    baromesh::SingleFlight<MethodResult::getAccelerometerData> accelerometerFlight;
+    baromesh::SingleFlight<MethodResult::getBatteryVoltage> batteryVoltageFlight;
+    baromesh::SingleFlight<MethodResult::getEncoderValues> encoderValuesFlight;
+    baromesh::SingleFlight<MethodResult::getJointStates> jointStatesFlight;
+
+    std::atomic<bool> writeCoalescing{false};
+    CoalescedWrite<uint32_t, MethodIn::setLedColor> ledColorWrites{&ledColorShadow, ledColorArgs};
+    CoalescedWrite<float, MethodIn::setBuzzerFrequency> buzzerFrequencyWrites{nullptr, buzzerFrequencyArgs};
+    CoalescedWrite<baromesh::JointValues, MethodIn::setMotorControllerOmega>
+        jointSpeedsWrites{&jointSpeedsShadow, jointSpeedsArgs};
+    CoalescedWrite<baromesh::JointValues, MethodIn::move> motorPowerWrites{nullptr, motorPowerArgs};
+
+    std::atomic<bool> shadowState{false};
+    baromesh::Shadow<uint32_t> ledColorShadow;
+    baromesh::Shadow<baromesh::JointValues> jointSpeedsShadow;
+    baromesh::Shadow<baromesh::JointValues> safetyThresholdsShadow;
+    baromesh::Shadow<baromesh::JointValues> safetyAnglesShadow;
+
+    mutable std::mutex clockMutex;
+    baromesh::ClockSync clock;
+
+    // Properties which cannot change while connected, served from here once
+    // known. Cleared when the connection terminates.
+    struct Identity {
+        bool hasSerialId = false;
+        char serialId[kSerialIdSize + 1];
+        bool hasFormFactor = false;
+        FormFactor::Type formFactor;
+        bool hasVersions = false;
+        uint32_t versions[3];
+    };
+    std::mutex identityMutex;
+    Identity identity;
+
+    std::mutex observersMutex;
+    std::vector<StateObserver*> observers;
+    std::atomic<double> observerGranularity{360.0};  // degrees
+
+    // Per-handle callbacks. Events fan out to every handle.
+    struct Handle {
+        std::function<void(Button::Type, ButtonState::Type, int)> buttonEventCallback;
+        std::function<void(int,double, int)> encoderEventCallback;
+        std::function<void(int,JointState::Type, int)> jointEventCallback;
+        std::function<void(double,double,double,int)> accelerometerEventCallback;
+        std::function<void(int)> connectionTerminatedCallback;
+        double encoderCallbackGranularity = 0;  // degrees
+    };
+    using Handles = std::map<const Linkbot*, Handle>;
+    std::mutex handlesMutex;
+    Handles handles;
+    // What forEachHandle iterates: a copy of handles, replaced on each change.
+    std::shared_ptr<const Handles> handlesSnapshot = std::make_shared<const Handles>();
+
+    // Registry bookkeeping, guarded by registry().mutex. A connection which
+    // is no longer connected is never handed to a new Linkbot.
+    int refs = 0;
+    std::vector<std::string> keys;
+    std::atomic<bool> connected{true};
 };
 
 Linkbot::Linkbot (const std::string& host, const std::string& service) try
@@ -228,99 +1157,240 @@ catch (std::exception& e) {
 }
 
 Linkbot::Linkbot (const std::string& id) try
-    : m(Linkbot::Impl::fromSerialId(id))
+    : m(Linkbot::Impl::fromString(id))
 {}
 catch (std::exception& e) {
     throw Error(id + ": " + e.what());
 }
 
 Linkbot::~Linkbot () {
-    delete m;
+    Impl::release(m, this);
+}
+
+/* WRITE COALESCING */
+
+void Linkbot::setWriteCoalescing (bool enable) {
+    m->writeCoalescing = enable;
+    if (!enable) {
+        m->drainWrites();
+    }
+}
+
+/* SHADOW STATE */
+
+void Linkbot::setShadowState (bool enable) {
+    m->shadowState = enable;
+}
+
+/* STATISTICS */
+
+void Linkbot::getCoalescingStats (uint64_t& sent, uint64_t& saved) const {
+    sent = m->accelerometerFlight.sent() + m->batteryVoltageFlight.sent()
+         + m->encoderValuesFlight.sent() + m->jointStatesFlight.sent();
+    saved = m->accelerometerFlight.saved() + m->batteryVoltageFlight.saved()
+          + m->encoderValuesFlight.saved() + m->jointStatesFlight.saved();
+}
+
+/* FLOW CONTROL */
+
+void Linkbot::setFlowControlLimit (unsigned maxInFlight) {
+    m->flow.setMaxWindow(maxInFlight);
 }
 
+void Linkbot::getFlowControlStats (double& window, unsigned& inFlight, unsigned& queued,
+                                   double& roundTripMicroseconds) const {
+    auto stats = m->flow.stats();
+    window = stats.window;
+    inFlight = stats.inFlight;
+    queued = stats.queued;
+    roundTripMicroseconds = stats.smoothedRoundTrip;
+}
+
+void Linkbot::getPriorityDispatchLatency (double& lastMicroseconds, double& maxMicroseconds) const {
+    lastMicroseconds = double(m->lastDispatchLatency.load());
+    maxMicroseconds = double(m->maxDispatchLatency.load());
+}
+
+/* TRACING */
+
+void Linkbot::startTrace (size_t capacity) {
+    baromesh::Tracer::global().start(capacity);
+}
+
+void Linkbot::stopTrace (const std::string& path) try {
+    baromesh::Tracer::global().stop(path);
+}
+catch (std::exception& e) {
+    throw Error(e.what());
+}
+
+/* I/O THREADS */
+
+void Linkbot::setIoThreadPool (unsigned threadCount, bool pinThreads, bool busyPoll) {
+    baromesh::IoPool::global().configure(threadCount, pinThreads, busyPoll);
+}
+
+std::vector<unsigned> Linkbot::ioShardLoads () {
+    return baromesh::IoPool::global().loads();
+}
+
+unsigned Linkbot::ioShard () const {
+    return m->io.shard();
+}
+
+
 using namespace std::placeholders; // _1, _2, etc.
 
 /* GETTERS */
 
 void Linkbot::getAccelerometer (int& timestamp, double&x, double&y, double&z)
 {
-    try {
-        auto value = asyncFire(m->robot, MethodIn::getAccelerometerData{}, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getAccelerometer(timestamp, x, y, z, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getAccelerometer (int& timestamp, double&x, double&y, double&z,
+                                boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodResult::getAccelerometerData value;
+    auto sendTime = int64_t{};
+    m->callCoalesced(m->accelerometerFlight, MethodIn::getAccelerometerData{},
+        value, ec, &sendTime);
+    if (!ec) {
         x = value.x;
         y = value.y;
         z = value.z;
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+        auto hostTime = hostNow();
+        timestamp = m->robotTimeOf(sendTime, hostTime);
+        m->notifyObservers([&] (StateObserver& o) {
+            o.onAccelerometer(x, y, z, timestamp, hostTime);
+        });
     }
 }
 
 std::vector<int> Linkbot::getAdcRaw()
 {
-    try {
-        std::vector<int> rvalues;
-        auto value = asyncFire( m->robot,
-                                MethodIn::getAdcRaw{},
-                                requestTimeout(),
-                                use_future).get();
-        for(auto i = 0; i < value.values_count; i++) {
-            rvalues.push_back(value.values[i]);
+    auto ec = boost::system::error_code{};
+    auto rvalues = getAdcRaw(ec);
+    throwIfError(ec);
+    return rvalues;
+}
+
+std::vector<int> Linkbot::getAdcRaw(boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    std::vector<int> rvalues;
+    MethodResult::getAdcRaw value;
+    m->call(MethodIn::getAdcRaw{}, value, ec);
+    if (!ec) {
+        try {
+            for(auto i = 0; i < value.values_count; i++) {
+                rvalues.push_back(value.values[i]);
+            }
+        }
+        catch (std::bad_alloc&) {
+            ec = make_error_code(boost::system::errc::not_enough_memory);
         }
-        return rvalues;
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
     }
+    return rvalues;
 }
 
 void Linkbot::getBatteryVoltage(double &volts)
 {
-    try {
-        auto value = asyncFire(m->robot, MethodIn::getBatteryVoltage{}, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getBatteryVoltage(volts, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getBatteryVoltage(double &volts, boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodResult::getBatteryVoltage value;
+    m->callCoalesced(m->batteryVoltageFlight, MethodIn::getBatteryVoltage{}, value, ec);
+    if (!ec) {
         volts = value.v;
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+        auto hostTime = hostNow();
+        m->notifyObservers([&] (StateObserver& o) {
+            o.onBatteryVoltage(volts, hostTime);
+        });
     }
 }
 
 void Linkbot::getFormFactor(FormFactor::Type& form)
 {
-    try {
-        auto value = asyncFire(m->robot, MethodIn::getFormFactor{}, requestTimeout(), use_future).get();
-        form = FormFactor::Type(value.value);
+    auto ec = boost::system::error_code{};
+    getFormFactor(form, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getFormFactor(FormFactor::Type& form, boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    {
+        std::lock_guard<std::mutex> lock{m->identityMutex};
+        if (m->identity.hasFormFactor) {
+            form = m->identity.formFactor;
+            ec = boost::system::error_code{};
+            return;
+        }
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
+    MethodResult::getFormFactor value;
+    m->call(MethodIn::getFormFactor{}, value, ec);
+    if (!ec) {
+        form = FormFactor::Type(value.value);
+        m->cacheFormFactor(form);
     }
 }
 
 void Linkbot::getJointAngles (int& timestamp, double& a0, double& a1, double& a2) {
-    try {
-        auto values = asyncFire(m->robot, MethodIn::getEncoderValues{}, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getJointAngles(timestamp, a0, a1, a2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getJointAngles (int& timestamp, double& a0, double& a1, double& a2,
+                              boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodResult::getEncoderValues values;
+    auto sendTime = int64_t{};
+    auto sent = m->callCoalesced(m->encoderValuesFlight, MethodIn::getEncoderValues{},
+        values, ec, &sendTime);
+    if (!ec) {
         assert(values.values_count >= 3);
         a0 = baromesh::radToDeg(values.values[0]);
         a1 = baromesh::radToDeg(values.values[1]);
         a2 = baromesh::radToDeg(values.values[2]);
         timestamp = values.timestamp;
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+        auto hostTime = hostNow();
+        // A caller which joined another's request only waited for part of its
+        // round trip, so only the sender's receive time makes a clock sample.
+        if (sent) {
+            m->addClockSample(sendTime, hostTime, timestamp);
+        }
+        m->notifyObservers([&] (StateObserver& o) {
+            o.onJointAngle(0, a0, timestamp, hostTime);
+            o.onJointAngle(1, a1, timestamp, hostTime);
+            o.onJointAngle(2, a2, timestamp, hostTime);
+        });
     }
 }
 
 void Linkbot::getJointSpeeds(double&s1, double&s2, double&s3)
 {
-    try {
-        auto values = asyncFire(m->robot, MethodIn::getMotorControllerOmega{}, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getJointSpeeds(s1, s2, s3, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getJointSpeeds(double&s1, double&s2, double&s3,
+                             boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodResult::getMotorControllerOmega values;
+    m->call(MethodIn::getMotorControllerOmega{}, values, ec);
+    if (!ec) {
         assert(values.values_count >= 3);
         s1 = baromesh::radToDeg(values.values[0]);
         s2 = baromesh::radToDeg(values.values[1]);
         s3 = baromesh::radToDeg(values.values[2]);
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
 }
 
 void Linkbot::getJointStates(int& timestamp,
@@ -328,118 +1398,251 @@ void Linkbot::getJointStates(int& timestamp,
                              JointState::Type& s2,
                              JointState::Type& s3)
 {
-    try {
-        auto values = asyncFire(m->robot, MethodIn::getJointStates{}, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getJointStates(timestamp, s1, s2, s3, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getJointStates(int& timestamp,
+                             JointState::Type& s1,
+                             JointState::Type& s2,
+                             JointState::Type& s3,
+                             boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodResult::getJointStates values;
+    auto sendTime = int64_t{};
+    m->callCoalesced(m->jointStatesFlight, MethodIn::getJointStates{}, values, ec, &sendTime);
+    if (!ec) {
         assert(values.values_count >= 3);
         s1 = static_cast<JointState::Type>(values.values[0]);
         s2 = static_cast<JointState::Type>(values.values[1]);
         s3 = static_cast<JointState::Type>(values.values[2]);
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+        auto hostTime = hostNow();
+        timestamp = m->robotTimeOf(sendTime, hostTime);
+        m->notifyObservers([&] (StateObserver& o) {
+            o.onJointState(0, s1, timestamp, hostTime);
+            o.onJointState(1, s2, timestamp, hostTime);
+            o.onJointState(2, s3, timestamp, hostTime);
+        });
     }
 }
 
 void Linkbot::getLedColor (int& r, int& g, int& b) {
-    try {
-        auto color = asyncFire(m->robot, MethodIn::getLedColor{}, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getLedColor(r, g, b, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getLedColor (int& r, int& g, int& b, boost::system::error_code& ec) BOOST_NOEXCEPT {
+    MethodResult::getLedColor color;
+    m->call(MethodIn::getLedColor{}, color, ec);
+    if (!ec) {
         r = 0xff & color.value >> 16;
         g = 0xff & color.value >> 8;
         b = 0xff & color.value;
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
 }
 
 void Linkbot::getVersions (uint32_t& major, uint32_t& minor, uint32_t& patch) {
-    try {
-        auto version = asyncFire(m->robot, MethodIn::getFirmwareVersion{}, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getVersions(major, minor, patch, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getVersions (uint32_t& major, uint32_t& minor, uint32_t& patch,
+                           boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    {
+        std::lock_guard<std::mutex> lock{m->identityMutex};
+        if (m->identity.hasVersions) {
+            major = m->identity.versions[0];
+            minor = m->identity.versions[1];
+            patch = m->identity.versions[2];
+            ec = boost::system::error_code{};
+            return;
+        }
+    }
+    MethodResult::getFirmwareVersion version;
+    m->call(MethodIn::getFirmwareVersion{}, version, ec);
+    if (!ec) {
         major = version.major;
         minor = version.minor;
         patch = version.patch;
-        BOOST_LOG(m->log) << "Firmware version "
-                           << major << '.' << minor << '.' << patch;
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+        m->cacheVersions(major, minor, patch);
     }
 }
 
 void Linkbot::getJointSafetyThresholds(int& t1, int& t2, int& t3)
 {
-    try {
-        auto value = asyncFire(m->robot,
-            MethodIn::getMotorControllerSafetyThreshold{},
-            requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getJointSafetyThresholds(t1, t2, t3, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getJointSafetyThresholds(int& t1, int& t2, int& t3,
+                                       boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodResult::getMotorControllerSafetyThreshold value;
+    m->call(MethodIn::getMotorControllerSafetyThreshold{}, value, ec);
+    if (!ec) {
         t1 = value.values[0];
         t2 = value.values[1];
         t3 = value.values[2];
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
 }
 
 void Linkbot::getJointSafetyAngles(double& t1, double& t2, double& t3)
 {
-    try {
-        auto rad2deg = [] (double x) -> double {return x*180.0/M_PI;};
-        auto value = asyncFire(m->robot,
-            MethodIn::getMotorControllerSafetyAngle{},
-            requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    getJointSafetyAngles(t1, t2, t3, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getJointSafetyAngles(double& t1, double& t2, double& t3,
+                                   boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto rad2deg = [] (double x) -> double {return x*180.0/M_PI;};
+    MethodResult::getMotorControllerSafetyAngle value;
+    m->call(MethodIn::getMotorControllerSafetyAngle{}, value, ec);
+    if (!ec) {
         t1 = rad2deg(value.values[0]);
         t2 = rad2deg(value.values[1]);
         t3 = rad2deg(value.values[2]);
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
 }
 
 void Linkbot::getSerialId(std::string& serialId)
 {
-    char buf[5];
-    readEeprom(0x412, 4, (uint8_t*)buf);
-    buf[4] = '\0';
-    serialId = std::string(buf);
+    auto ec = boost::system::error_code{};
+    getSerialId(serialId, ec);
+    throwIfError(ec);
 }
 
-/* SETTERS */
-void Linkbot::resetEncoderRevs() {
-    try {
-        asyncFire(m->robot, MethodIn::resetEncoderRevs{}, requestTimeout(), use_future).get();
+void Linkbot::getSerialId(std::string& serialId, boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    // Fits in the small-string buffer, so this does not allocate.
+    {
+        std::lock_guard<std::mutex> lock{m->identityMutex};
+        if (m->identity.hasSerialId) {
+            serialId.assign(m->identity.serialId);
+            ec = boost::system::error_code{};
+            return;
+        }
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
+    char buf[kSerialIdSize + 1];
+    readEeprom(kSerialIdAddress, kSerialIdSize, (uint8_t*)buf, ec);
+    if (!ec) {
+        buf[kSerialIdSize] = '\0';
+        m->cacheSerialId(buf);
+        serialId.assign(buf);
     }
 }
 
+void Linkbot::getRobotState(RobotState& state)
+{
+    auto ec = boost::system::error_code{};
+    getRobotState(state, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::getRobotState(RobotState& state, boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodResult::getEncoderValues angles;
+    MethodResult::getMotorControllerOmega speeds;
+    MethodResult::getJointStates states;
+    MethodResult::getAccelerometerData accel;
+    MethodResult::getBatteryVoltage battery;
+    MethodResult::getLedColor color;
+
+    auto sendTime = hostNow();
+    Impl::Batch batch{*m, 6};
+    batch.fire(MethodIn::getEncoderValues{}, angles, state.jointAnglesHostTime);
+    batch.fire(MethodIn::getMotorControllerOmega{}, speeds, state.jointSpeedsHostTime);
+    batch.fire(MethodIn::getJointStates{}, states, state.jointStatesHostTime);
+    batch.fire(MethodIn::getAccelerometerData{}, accel, state.accelerometerHostTime);
+    batch.fire(MethodIn::getBatteryVoltage{}, battery, state.batteryVoltageHostTime);
+    batch.fire(MethodIn::getLedColor{}, color, state.ledColorHostTime);
+    batch.wait(ec);
+    if (ec) {
+        return;
+    }
+
+    assert(angles.values_count >= 3);
+    assert(speeds.values_count >= 3);
+    assert(states.values_count >= 3);
+    state.jointAnglesTimestamp = angles.timestamp;
+    m->addClockSample(sendTime, state.jointAnglesHostTime, angles.timestamp);
+    for (int i = 0; i < 3; ++i) {
+        state.jointAngles[i] = baromesh::radToDeg(angles.values[i]);
+        state.jointSpeeds[i] = baromesh::radToDeg(speeds.values[i]);
+        state.jointStates[i] = static_cast<JointState::Type>(states.values[i]);
+    }
+    state.accelerometer[0] = accel.x;
+    state.accelerometer[1] = accel.y;
+    state.accelerometer[2] = accel.z;
+    state.batteryVoltage = battery.v;
+    state.ledColor[0] = 0xff & color.value >> 16;
+    state.ledColor[1] = 0xff & color.value >> 8;
+    state.ledColor[2] = 0xff & color.value;
+
+    m->notifyObservers([&state] (StateObserver& o) {
+        for (int i = 0; i < 3; ++i) {
+            o.onJointAngle(i, state.jointAngles[i], state.jointAnglesTimestamp,
+                state.jointAnglesHostTime);
+            o.onJointState(i, state.jointStates[i], 0, state.jointStatesHostTime);
+        }
+        o.onAccelerometer(state.accelerometer[0], state.accelerometer[1],
+            state.accelerometer[2], 0, state.accelerometerHostTime);
+        o.onBatteryVoltage(state.batteryVoltage, state.batteryVoltageHostTime);
+    });
+}
+
+/* SETTERS */
+void Linkbot::resetEncoderRevs() {
+    auto ec = boost::system::error_code{};
+    resetEncoderRevs(ec);
+    throwIfError(ec);
+}
+
+void Linkbot::resetEncoderRevs(boost::system::error_code& ec) BOOST_NOEXCEPT {
+    m->call(MethodIn::resetEncoderRevs{}, ec);
+}
+
 void Linkbot::setBuzzerFrequency (double freq) {
-    try {
-        asyncFire(m->robot, MethodIn::setBuzzerFrequency{float(freq)}, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+    auto ec = boost::system::error_code{};
+    setBuzzerFrequency(freq, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setBuzzerFrequency (double freq, boost::system::error_code& ec) BOOST_NOEXCEPT {
+    if (m->writeCoalescing) {
+        m->post(m->buzzerFrequencyWrites, float(freq), ec);
+        return;
     }
+    m->call(buzzerFrequencyArgs(float(freq)), ec);
 }
 
 void Linkbot::setJointSpeeds (int mask, double s0, double s1, double s2) {
-    try {
-        MethodIn::setMotorControllerOmega arg;
-        arg.mask = mask;
-        arg.values_count = 0;
-        int jointFlag = 0x01;
-        for (auto& s : { s0, s1, s2 }) {
-            if (jointFlag & mask) {
-                arg.values[arg.values_count++] = float(baromesh::degToRad(s));
-            }
-            jointFlag <<= 1;
-        }
-        asyncFire(m->robot, arg, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    setJointSpeeds(mask, s0, s1, s2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setJointSpeeds (int mask, double s0, double s1, double s2,
+                              boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto speeds = baromesh::JointValues{mask, { s0, s1, s2 }};
+    if (m->writeCoalescing) {
+        m->post(m->jointSpeedsWrites, speeds, ec);
+        return;
+    }
+    if (m->elide(m->jointSpeedsShadow, speeds)) {
+        ec = boost::system::error_code{};
+        return;
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
+    m->call(jointSpeedsArgs(speeds), ec);
+    if (!ec) {
+        m->jointSpeedsShadow.update(speeds);
     }
 }
 
@@ -449,6 +1652,19 @@ void Linkbot::setJointStates(
         JointState::Type s2, double d2,
         JointState::Type s3, double d3
         )
+{
+    auto ec = boost::system::error_code{};
+    setJointStates(mask, s1, d1, s2, d2, s3, d3, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setJointStates(
+        int mask,
+        JointState::Type s1, double d1,
+        JointState::Type s2, double d2,
+        JointState::Type s3, double d3,
+        boost::system::error_code& ec
+        ) BOOST_NOEXCEPT
 {
     barobo_Robot_Goal_Type goalType[3];
     barobo_Robot_Goal_Controller controllerType[3];
@@ -480,16 +1696,11 @@ void Linkbot::setJointStates(
                 break;
         }
     }
-    try {
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), { goalType[0], coefficients[0], true, controllerType[0] },
-            bool(mask&0x02), { goalType[1], coefficients[1], true, controllerType[1] },
-            bool(mask&0x04), { goalType[2], coefficients[2], true, controllerType[2] }
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    m->call(MethodIn::move {
+        bool(mask&0x01), { goalType[0], coefficients[0], true, controllerType[0] },
+        bool(mask&0x02), { goalType[1], coefficients[1], true, controllerType[1] },
+        bool(mask&0x04), { goalType[2], coefficients[2], true, controllerType[2] }
+    }, ec);
 }
 
 void Linkbot::setJointStates(
@@ -498,6 +1709,22 @@ void Linkbot::setJointStates(
         JointState::Type s2, double d2, double timeout2, JointState::Type end2,
         JointState::Type s3, double d3, double timeout3, JointState::Type end3
         )
+{
+    auto ec = boost::system::error_code{};
+    setJointStates(mask,
+        s1, d1, timeout1, end1,
+        s2, d2, timeout2, end2,
+        s3, d3, timeout3, end3, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setJointStates(
+        int mask,
+        JointState::Type s1, double d1, double timeout1, JointState::Type end1,
+        JointState::Type s2, double d2, double timeout2, JointState::Type end2,
+        JointState::Type s3, double d3, double timeout3, JointState::Type end3,
+        boost::system::error_code& ec
+        ) BOOST_NOEXCEPT
 {
     barobo_Robot_Goal_Type goalType[3];
     barobo_Robot_Goal_Controller controllerType[3];
@@ -534,83 +1761,111 @@ void Linkbot::setJointStates(
                 break;
         }
     }
-    try {
-        auto js_to_int = [] (JointState::Type js) {
-            switch(js) {
-                case JointState::COAST:
-                    return barobo_Robot_JointState_COAST;
-                case JointState::HOLD:
-                    return barobo_Robot_JointState_HOLD;
-                case JointState::MOVING:
-                    return barobo_Robot_JointState_MOVING;
-                default:
-                    return barobo_Robot_JointState_COAST;
-            }
-        };
-
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01),
-            { goalType[0], coefficients[0], true, controllerType[0],
-                hasTimeouts[0], float(timeout1), hasTimeouts[0], js_to_int(end1)},
-            bool(mask&0x02),
-            { goalType[1], coefficients[1], true, controllerType[1],
-                hasTimeouts[1], float(timeout2), hasTimeouts[1], js_to_int(end2)},
-            bool(mask&0x04),
-            { goalType[2], coefficients[2], true, controllerType[2],
-                hasTimeouts[2], float(timeout3), hasTimeouts[2], js_to_int(end3)}
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto js_to_int = [] (JointState::Type js) {
+        switch(js) {
+            case JointState::COAST:
+                return barobo_Robot_JointState_COAST;
+            case JointState::HOLD:
+                return barobo_Robot_JointState_HOLD;
+            case JointState::MOVING:
+                return barobo_Robot_JointState_MOVING;
+            default:
+                return barobo_Robot_JointState_COAST;
+        }
+    };
+
+    m->call(MethodIn::move {
+        bool(mask&0x01),
+        { goalType[0], coefficients[0], true, controllerType[0],
+            hasTimeouts[0], float(timeout1), hasTimeouts[0], js_to_int(end1)},
+        bool(mask&0x02),
+        { goalType[1], coefficients[1], true, controllerType[1],
+            hasTimeouts[1], float(timeout2), hasTimeouts[1], js_to_int(end2)},
+        bool(mask&0x04),
+        { goalType[2], coefficients[2], true, controllerType[2],
+            hasTimeouts[2], float(timeout3), hasTimeouts[2], js_to_int(end3)}
+    }, ec);
 }
 
 void Linkbot::setLedColor (int r, int g, int b) {
-    try {
-        asyncFire(m->robot, MethodIn::setLedColor{
-            uint32_t(r << 16 | g << 8 | b)
-        }, requestTimeout(), use_future).get();
+    auto ec = boost::system::error_code{};
+    setLedColor(r, g, b, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setLedColor (int r, int g, int b, boost::system::error_code& ec) BOOST_NOEXCEPT {
+    auto rgb = uint32_t(r << 16 | g << 8 | b);
+    if (m->writeCoalescing) {
+        m->post(m->ledColorWrites, rgb, ec);
+        return;
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
+    if (m->elide(m->ledColorShadow, rgb)) {
+        ec = boost::system::error_code{};
+        return;
+    }
+    m->call(ledColorArgs(rgb), ec);
+    if (!ec) {
+        m->ledColorShadow.update(rgb);
     }
 }
 
 void Linkbot::setJointSafetyThresholds(int mask, int t0, int t1, int t2) {
-    try {
-        MethodIn::setMotorControllerSafetyThreshold arg;
-        arg.mask = mask;
-        arg.values_count = 0;
-        int jointFlag = 0x01;
-        for (auto& t : { t0, t1, t2 }) {
-            if (jointFlag & mask) {
-                arg.values[arg.values_count++] = t;
-            }
-            jointFlag <<= 1;
+    auto ec = boost::system::error_code{};
+    setJointSafetyThresholds(mask, t0, t1, t2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setJointSafetyThresholds(int mask, int t0, int t1, int t2,
+                                       boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto thresholds = baromesh::JointValues{mask, { double(t0), double(t1), double(t2) }};
+    if (m->elide(m->safetyThresholdsShadow, thresholds)) {
+        ec = boost::system::error_code{};
+        return;
+    }
+    MethodIn::setMotorControllerSafetyThreshold arg;
+    arg.mask = mask;
+    arg.values_count = 0;
+    int jointFlag = 0x01;
+    for (auto& t : { t0, t1, t2 }) {
+        if (jointFlag & mask) {
+            arg.values[arg.values_count++] = t;
         }
-        asyncFire(m->robot, arg, requestTimeout(), use_future).get();
+        jointFlag <<= 1;
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
+    m->call(arg, ec, Priority::URGENT);
+    if (!ec) {
+        m->safetyThresholdsShadow.update(thresholds);
     }
 }
 
 void Linkbot::setJointSafetyAngles(int mask, double t0, double t1, double t2) {
-    try {
-        MethodIn::setMotorControllerSafetyAngle arg;
-        arg.mask = mask;
-        arg.values_count = 0;
-        int jointFlag = 0x01;
-        for (auto& t : { t0, t1, t2 }) {
-            if (jointFlag & mask) {
-                arg.values[arg.values_count++] = float(baromesh::degToRad(t));
-            }
-            jointFlag <<= 1;
+    auto ec = boost::system::error_code{};
+    setJointSafetyAngles(mask, t0, t1, t2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setJointSafetyAngles(int mask, double t0, double t1, double t2,
+                                   boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto angles = baromesh::JointValues{mask, { t0, t1, t2 }};
+    if (m->elide(m->safetyAnglesShadow, angles)) {
+        ec = boost::system::error_code{};
+        return;
+    }
+    MethodIn::setMotorControllerSafetyAngle arg;
+    arg.mask = mask;
+    arg.values_count = 0;
+    int jointFlag = 0x01;
+    for (auto& t : { t0, t1, t2 }) {
+        if (jointFlag & mask) {
+            arg.values[arg.values_count++] = float(baromesh::degToRad(t));
         }
-        asyncFire(m->robot, arg, requestTimeout(), use_future).get();
+        jointFlag <<= 1;
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
+    m->call(arg, ec, Priority::URGENT);
+    if (!ec) {
+        m->safetyAnglesShadow.update(angles);
     }
 }
 
@@ -618,135 +1873,171 @@ void Linkbot::setJointAccelI(
     int mask,
     double a0, double a1, double a2)
 {
-    try {
-        MethodIn::setMotorControllerAlphaI arg;
-        arg.mask = mask;
-        arg.values_count = 0;
-        int jointFlag = 0x01;
-        for (auto& s : { a0, a1, a2 }) {
-            if (jointFlag & mask) {
-                arg.values[arg.values_count++] = float(baromesh::degToRad(s));
-            }
-            jointFlag <<= 1;
+    auto ec = boost::system::error_code{};
+    setJointAccelI(mask, a0, a1, a2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setJointAccelI(
+    int mask,
+    double a0, double a1, double a2,
+    boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodIn::setMotorControllerAlphaI arg;
+    arg.mask = mask;
+    arg.values_count = 0;
+    int jointFlag = 0x01;
+    for (auto& s : { a0, a1, a2 }) {
+        if (jointFlag & mask) {
+            arg.values[arg.values_count++] = float(baromesh::degToRad(s));
         }
-        asyncFire(m->robot, arg, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+        jointFlag <<= 1;
     }
+    m->call(arg, ec);
 }
 
 void Linkbot::setJointAccelF(
     int mask,
     double a0, double a1, double a2)
 {
-    try {
-        MethodIn::setMotorControllerAlphaF arg;
-        arg.mask = mask;
-        arg.values_count = 0;
-        int jointFlag = 0x01;
-        for (auto& s : { a0, a1, a2 }) {
-            if (jointFlag & mask) {
-                arg.values[arg.values_count++] = float(baromesh::degToRad(s));
-            }
-            jointFlag <<= 1;
+    auto ec = boost::system::error_code{};
+    setJointAccelF(mask, a0, a1, a2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setJointAccelF(
+    int mask,
+    double a0, double a1, double a2,
+    boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    MethodIn::setMotorControllerAlphaF arg;
+    arg.mask = mask;
+    arg.values_count = 0;
+    int jointFlag = 0x01;
+    for (auto& s : { a0, a1, a2 }) {
+        if (jointFlag & mask) {
+            arg.values[arg.values_count++] = float(baromesh::degToRad(s));
         }
-        asyncFire(m->robot, arg, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+        jointFlag <<= 1;
     }
+    m->call(arg, ec);
 }
 /* MOVEMENT */
 
 void Linkbot::drive (int mask, double a0, double a1, double a2)
 {
-    try {
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), { barobo_Robot_Goal_Type_RELATIVE,
-                               float(baromesh::degToRad(a0)),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             },
-            bool(mask&0x02), { barobo_Robot_Goal_Type_RELATIVE,
-                               float(baromesh::degToRad(a1)),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             },
-            bool(mask&0x04), { barobo_Robot_Goal_Type_RELATIVE,
-                               float(baromesh::degToRad(a2)),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             }
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    drive(mask, a0, a1, a2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::drive (int mask, double a0, double a1, double a2,
+                     boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    m->call(MethodIn::move {
+        bool(mask&0x01), { barobo_Robot_Goal_Type_RELATIVE,
+                           float(baromesh::degToRad(a0)),
+                           true,
+                           barobo_Robot_Goal_Controller_PID
+                         },
+        bool(mask&0x02), { barobo_Robot_Goal_Type_RELATIVE,
+                           float(baromesh::degToRad(a1)),
+                           true,
+                           barobo_Robot_Goal_Controller_PID
+                         },
+        bool(mask&0x04), { barobo_Robot_Goal_Type_RELATIVE,
+                           float(baromesh::degToRad(a2)),
+                           true,
+                           barobo_Robot_Goal_Controller_PID
+                         }
+    }, ec);
 }
 
 void Linkbot::driveTo (int mask, double a0, double a1, double a2)
 {
-    try {
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), { barobo_Robot_Goal_Type_ABSOLUTE,
-                               float(baromesh::degToRad(a0)),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             },
-            bool(mask&0x02), { barobo_Robot_Goal_Type_ABSOLUTE,
-                               float(baromesh::degToRad(a1)),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             },
-            bool(mask&0x04), { barobo_Robot_Goal_Type_ABSOLUTE,
-                               float(baromesh::degToRad(a2)),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             }
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    driveTo(mask, a0, a1, a2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::driveTo (int mask, double a0, double a1, double a2,
+                       boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    m->call(MethodIn::move {
+        bool(mask&0x01), { barobo_Robot_Goal_Type_ABSOLUTE,
+                           float(baromesh::degToRad(a0)),
+                           true,
+                           barobo_Robot_Goal_Controller_PID
+                         },
+        bool(mask&0x02), { barobo_Robot_Goal_Type_ABSOLUTE,
+                           float(baromesh::degToRad(a1)),
+                           true,
+                           barobo_Robot_Goal_Controller_PID
+                         },
+        bool(mask&0x04), { barobo_Robot_Goal_Type_ABSOLUTE,
+                           float(baromesh::degToRad(a2)),
+                           true,
+                           barobo_Robot_Goal_Controller_PID
+                         }
+    }, ec);
 }
 
 void Linkbot::move (int mask, double a0, double a1, double a2) {
-    try {
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), { barobo_Robot_Goal_Type_RELATIVE,
-                               float(baromesh::degToRad(a0)),
-                               false},
-            bool(mask&0x02), { barobo_Robot_Goal_Type_RELATIVE,
-                               float(baromesh::degToRad(a1)),
-                               false},
-            bool(mask&0x04), { barobo_Robot_Goal_Type_RELATIVE,
-                               float(baromesh::degToRad(a2)),
-                               false}
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    move(mask, a0, a1, a2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::move (int mask, double a0, double a1, double a2,
+                    boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    m->call(MethodIn::move {
+        bool(mask&0x01), { barobo_Robot_Goal_Type_RELATIVE,
+                           float(baromesh::degToRad(a0)),
+                           false},
+        bool(mask&0x02), { barobo_Robot_Goal_Type_RELATIVE,
+                           float(baromesh::degToRad(a1)),
+                           false},
+        bool(mask&0x04), { barobo_Robot_Goal_Type_RELATIVE,
+                           float(baromesh::degToRad(a2)),
+                           false}
+    }, ec);
 }
 
 void Linkbot::moveContinuous (int mask, double c0, double c1, double c2) {
-    try {
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), { barobo_Robot_Goal_Type_INFINITE, float(c0), false },
-            bool(mask&0x02), { barobo_Robot_Goal_Type_INFINITE, float(c1), false },
-            bool(mask&0x04), { barobo_Robot_Goal_Type_INFINITE, float(c2), false }
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    moveContinuous(mask, c0, c1, c2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::moveContinuous (int mask, double c0, double c1, double c2,
+                              boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    m->call(MethodIn::move {
+        bool(mask&0x01), { barobo_Robot_Goal_Type_INFINITE, float(c0), false },
+        bool(mask&0x02), { barobo_Robot_Goal_Type_INFINITE, float(c1), false },
+        bool(mask&0x04), { barobo_Robot_Goal_Type_INFINITE, float(c2), false }
+    }, ec);
 }
 
 void Linkbot::moveAccel(int mask, int relativeMask,
     double omega0_i, double timeout0, JointState::Type endstate0,
     double omega1_i, double timeout1, JointState::Type endstate1,
     double omega2_i, double timeout2, JointState::Type endstate2)
+{
+    auto ec = boost::system::error_code{};
+    moveAccel(mask, relativeMask,
+        omega0_i, timeout0, endstate0,
+        omega1_i, timeout1, endstate1,
+        omega2_i, timeout2, endstate2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::moveAccel(int mask, int relativeMask,
+    double omega0_i, double timeout0, JointState::Type endstate0,
+    double omega1_i, double timeout1, JointState::Type endstate1,
+    double omega2_i, double timeout2, JointState::Type endstate2,
+    boost::system::error_code& ec) BOOST_NOEXCEPT
 {
     bool hasTimeouts[3];
     hasTimeouts[0] = (timeout0 != 0.0);
@@ -760,50 +2051,53 @@ void Linkbot::moveAccel(int mask, int relativeMask,
             motionType[i] = barobo_Robot_Goal_Type_ABSOLUTE;
         }
     }
-    try {
-        auto js_to_int = [] (JointState::Type js) {
-            switch(js) {
-                case JointState::COAST:
-                    return barobo_Robot_JointState_COAST;
-                case JointState::HOLD:
-                    return barobo_Robot_JointState_HOLD;
-                case JointState::MOVING:
-                    return barobo_Robot_JointState_MOVING;
-                default:
-                    return barobo_Robot_JointState_COAST;
+    auto js_to_int = [] (JointState::Type js) {
+        switch(js) {
+            case JointState::COAST:
+                return barobo_Robot_JointState_COAST;
+            case JointState::HOLD:
+                return barobo_Robot_JointState_HOLD;
+            case JointState::MOVING:
+                return barobo_Robot_JointState_MOVING;
+            default:
+                return barobo_Robot_JointState_COAST;
+        }
+    };
+
+    m->call(MethodIn::move {
+        bool(mask&0x01), {
+            motionType[0],
+            float(baromesh::degToRad(omega0_i)),
+            true,
+            barobo_Robot_Goal_Controller_ACCEL,
+            hasTimeouts[0], float(timeout0), hasTimeouts[0], js_to_int(endstate0)
+            },
+        bool(mask&0x02), {
+            motionType[1],
+            float(baromesh::degToRad(omega1_i)),
+            true,
+            barobo_Robot_Goal_Controller_ACCEL,
+            hasTimeouts[1], float(timeout1), hasTimeouts[1], js_to_int(endstate1)
+            },
+        bool(mask&0x04), {
+            motionType[2],
+            float(baromesh::degToRad(omega2_i)),
+            true,
+            barobo_Robot_Goal_Controller_ACCEL,
+            hasTimeouts[2], float(timeout2), hasTimeouts[2], js_to_int(endstate2)
             }
-        };
-
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), {
-                motionType[0],
-                float(baromesh::degToRad(omega0_i)),
-                true,
-                barobo_Robot_Goal_Controller_ACCEL,
-                hasTimeouts[0], float(timeout0), hasTimeouts[0], js_to_int(endstate0)
-                },
-            bool(mask&0x02), {
-                motionType[1],
-                float(baromesh::degToRad(omega1_i)),
-                true,
-                barobo_Robot_Goal_Controller_ACCEL,
-                hasTimeouts[1], float(timeout1), hasTimeouts[1], js_to_int(endstate1)
-                },
-            bool(mask&0x04), {
-                motionType[2],
-                float(baromesh::degToRad(omega2_i)),
-                true,
-                barobo_Robot_Goal_Controller_ACCEL,
-                hasTimeouts[2], float(timeout2), hasTimeouts[2], js_to_int(endstate2)
-                }
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    }, ec);
 }
 
 void Linkbot::moveSmooth(int mask, int relativeMask, double a0, double a1, double a2)
+{
+    auto ec = boost::system::error_code{};
+    moveSmooth(mask, relativeMask, a0, a1, a2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::moveSmooth(int mask, int relativeMask, double a0, double a1, double a2,
+                         boost::system::error_code& ec) BOOST_NOEXCEPT
 {
     barobo_Robot_Goal_Type motionType[3];
     for(int i = 0; i < 3; i++) {
@@ -814,237 +2108,373 @@ void Linkbot::moveSmooth(int mask, int relativeMask, double a0, double a1, doubl
         }
     }
 
-    try {
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), {
-                motionType[0],
-                float(baromesh::degToRad(a0)),
-                true,
-                barobo_Robot_Goal_Controller_SMOOTH
-                },
-            bool(mask&0x02), {
-                motionType[1],
-                float(baromesh::degToRad(a1)),
-                true,
-                barobo_Robot_Goal_Controller_SMOOTH
-                },
-            bool(mask&0x04), {
-                motionType[2],
-                float(baromesh::degToRad(a2)),
-                true,
-                barobo_Robot_Goal_Controller_SMOOTH
-                }
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    m->call(MethodIn::move {
+        bool(mask&0x01), {
+            motionType[0],
+            float(baromesh::degToRad(a0)),
+            true,
+            barobo_Robot_Goal_Controller_SMOOTH
+            },
+        bool(mask&0x02), {
+            motionType[1],
+            float(baromesh::degToRad(a1)),
+            true,
+            barobo_Robot_Goal_Controller_SMOOTH
+            },
+        bool(mask&0x04), {
+            motionType[2],
+            float(baromesh::degToRad(a2)),
+            true,
+            barobo_Robot_Goal_Controller_SMOOTH
+            }
+    }, ec);
 }
 
 void Linkbot::moveTo (int mask, double a0, double a1, double a2) {
-    try {
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), { barobo_Robot_Goal_Type_ABSOLUTE, float(baromesh::degToRad(a0)) },
-            bool(mask&0x02), { barobo_Robot_Goal_Type_ABSOLUTE, float(baromesh::degToRad(a1)) },
-            bool(mask&0x04), { barobo_Robot_Goal_Type_ABSOLUTE, float(baromesh::degToRad(a2)) }
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    moveTo(mask, a0, a1, a2, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::moveTo (int mask, double a0, double a1, double a2,
+                      boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    m->call(MethodIn::move {
+        bool(mask&0x01), { barobo_Robot_Goal_Type_ABSOLUTE, float(baromesh::degToRad(a0)) },
+        bool(mask&0x02), { barobo_Robot_Goal_Type_ABSOLUTE, float(baromesh::degToRad(a1)) },
+        bool(mask&0x04), { barobo_Robot_Goal_Type_ABSOLUTE, float(baromesh::degToRad(a2)) }
+    }, ec);
 }
 
 void Linkbot::motorPower(int mask, int m1, int m2, int m3)
 {
-    try {
-        asyncFire(m->robot, MethodIn::move {
-            bool(mask&0x01), { barobo_Robot_Goal_Type_INFINITE,
-                               float(m1),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             },
-            bool(mask&0x02), { barobo_Robot_Goal_Type_INFINITE,
-                               float(m2),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             },
-            bool(mask&0x04), { barobo_Robot_Goal_Type_INFINITE,
-                               float(m3),
-                               true,
-                               barobo_Robot_Goal_Controller_PID
-                             }
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    motorPower(mask, m1, m2, m3, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::motorPower(int mask, int m1, int m2, int m3,
+                         boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto power = baromesh::JointValues{mask, { double(m1), double(m2), double(m3) }};
+    auto off = true;
+    for (int i = 0; i < 3; ++i) {
+        off = off && (!(mask & (1 << i)) || 0 == power.values[i]);
+    }
+    if (off) {
+        // Cutting power is a stop: it must not wait behind, or be undone by,
+        // power levels set earlier.
+        m->motorPowerWrites.slot.withdraw(mask);
+        m->call(motorPowerArgs(power), ec, Priority::STOP);
+        return;
+    }
+    if (m->writeCoalescing) {
+        m->post(m->motorPowerWrites, power, ec);
+        return;
+    }
+    m->call(motorPowerArgs(power), ec);
 }
 
 void Linkbot::stop (int mask) {
-    try {
-        asyncFire(m->robot, MethodIn::stop{true, static_cast<uint32_t>(mask)}, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    stop(mask, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::stop (int mask, boost::system::error_code& ec) BOOST_NOEXCEPT {
+    m->motorPowerWrites.slot.withdraw(mask);
+    m->call(MethodIn::stop{true, static_cast<uint32_t>(mask)}, ec, Priority::STOP);
 }
 
 /* CALLBACKS */
 
 void Linkbot::setAccelerometerEventCallback (AccelerometerEventCallback cb, void* userData) {
-    const bool enable = !!cb;
-    auto granularity = float(enable ? 0.05 : 0);
-
-    try {
-        asyncFire(m->robot, MethodIn::enableAccelerometerEvent {
-            enable, granularity
-        }, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    setAccelerometerEventCallback(cb, userData, ec);
+    throwIfError(ec);
+}
 
-    if (enable) {
-        m->accelerometerEventCallback = std::bind(cb, _1, _2, _3, _4, userData);
-    }
-    else {
-        m->accelerometerEventCallback = nullptr;
+void Linkbot::setAccelerometerEventCallback (AccelerometerEventCallback cb, void* userData,
+                                             boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto callback = std::function<void(double,double,double,int)>{};
+    if (cb) {
+        callback = std::bind(cb, _1, _2, _3, _4, userData);
     }
+    m->setCallback(this, &Impl::Handle::accelerometerEventCallback, callback,
+                   &Impl::syncAccelerometerEvents, ec);
 }
 
 void Linkbot::setButtonEventCallback (ButtonEventCallback cb, void* userData) {
-    const bool enable = !!cb;
-
-    try {
-        asyncFire(m->robot, MethodIn::enableButtonEvent{enable}, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+    auto ec = boost::system::error_code{};
+    setButtonEventCallback(cb, userData, ec);
+    throwIfError(ec);
+}
 
-    if (enable) {
-        m->buttonEventCallback = std::bind(cb, _1, _2, _3, userData);
-    }
-    else {
-        m->buttonEventCallback = nullptr;
+void Linkbot::setButtonEventCallback (ButtonEventCallback cb, void* userData,
+                                      boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto callback = std::function<void(Button::Type, ButtonState::Type, int)>{};
+    if (cb) {
+        callback = std::bind(cb, _1, _2, _3, userData);
     }
+    m->setCallback(this, &Impl::Handle::buttonEventCallback, callback,
+                   &Impl::syncButtonEvents, ec);
 }
 
 void Linkbot::setEncoderEventCallback (EncoderEventCallback cb,
                                        double granularity, void* userData)
 {
-    const bool enable = !!cb;
-    granularity = baromesh::degToRad(granularity);
+    auto ec = boost::system::error_code{};
+    setEncoderEventCallback(cb, granularity, userData, ec);
+    throwIfError(ec);
+}
 
+void Linkbot::setEncoderEventCallback (EncoderEventCallback cb,
+                                       double granularity, void* userData,
+                                       boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto callback = std::function<void(int,double, int)>{};
+    if (cb) {
+        callback = std::bind(cb, _1, _2, _3, userData);
+    }
+    auto previousGranularity = granularity;
+    auto swap = [&] {
+        std::lock_guard<std::mutex> lock{m->handlesMutex};
+        auto& h = m->handles[this];
+        std::swap(h.encoderEventCallback, callback);
+        std::swap(h.encoderCallbackGranularity, previousGranularity);
+        m->publishHandles();
+    };
     try {
-        asyncFire(m->robot, MethodIn::enableEncoderEvent {
-            true, { enable, float(granularity) },
-            true, { enable, float(granularity) },
-            true, { enable, float(granularity) }
-        }, requestTimeout(), use_future).get();
+        swap();
+        m->syncEncoderEvents(ec);
+        if (ec) {
+            swap();
+        }
+    }
+    catch (std::bad_alloc&) {
+        ec = make_error_code(boost::system::errc::not_enough_memory);
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
+}
+
+void Linkbot::setJointEventCallback (JointEventCallback cb, void* userData) {
+    auto ec = boost::system::error_code{};
+    setJointEventCallback(cb, userData, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::setJointEventCallback (JointEventCallback cb, void* userData,
+                                     boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    auto callback = std::function<void(int,JointState::Type, int)>{};
+    if (cb) {
+        callback = std::bind(cb, _1, _2, _3, userData);
     }
+    m->setCallback(this, &Impl::Handle::jointEventCallback, callback,
+                   &Impl::syncJointEvents, ec);
+}
+
+void Linkbot::setConnectionTerminatedCallback (ConnectionTerminatedCallback cb, void* userData) {
+    auto ec = boost::system::error_code{};
+    setConnectionTerminatedCallback(cb, userData, ec);
+    throwIfError(ec);
+}
 
-    if (enable) {
-        m->encoderEventCallback = std::bind(cb, _1, _2, _3, userData);
+void Linkbot::setConnectionTerminatedCallback (ConnectionTerminatedCallback cb, void* userData,
+                                               boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    ec = boost::system::error_code{};
+    try {
+        auto callback = std::function<void(int)>{};
+        if (cb) {
+            callback = std::bind(cb, _1, userData);
+        }
+        std::lock_guard<std::mutex> lock{m->handlesMutex};
+        m->handles[this].connectionTerminatedCallback = callback;
+        m->publishHandles();
     }
-    else {
-        m->encoderEventCallback = nullptr;
+    catch (std::bad_alloc&) {
+        ec = make_error_code(boost::system::errc::not_enough_memory);
     }
 }
 
-void Linkbot::setJointEventCallback (JointEventCallback cb, void* userData) {
-    const bool enable = !!cb;
+/* STATE OBSERVERS */
+
+void Linkbot::addStateObserver (StateObserver* observer, double encoderGranularity) {
+    auto ec = boost::system::error_code{};
+    addStateObserver(observer, encoderGranularity, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::addStateObserver (StateObserver* observer, double encoderGranularity,
+                                boost::system::error_code& ec) BOOST_NOEXCEPT
+{
     try {
-        asyncFire(m->robot, MethodIn::enableJointEvent {
-            enable
-        }, requestTimeout(), use_future).get();
+        std::lock_guard<std::mutex> lock{m->observersMutex};
+        m->observers.push_back(observer);
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
+    catch (std::bad_alloc&) {
+        ec = make_error_code(boost::system::errc::not_enough_memory);
+        return;
     }
+    if (encoderGranularity < m->observerGranularity) {
+        m->observerGranularity = encoderGranularity;
+    }
+    m->syncObserverEvents(ec);
+}
+
+void Linkbot::removeStateObserver (StateObserver* observer) {
+    auto ec = boost::system::error_code{};
+    removeStateObserver(observer, ec);
+    throwIfError(ec);
+}
 
-    if (enable) {
-        m->jointEventCallback = std::bind(cb, _1, _2, _3, userData);
+void Linkbot::removeStateObserver (StateObserver* observer,
+                                   boost::system::error_code& ec) BOOST_NOEXCEPT
+{
+    {
+        std::lock_guard<std::mutex> lock{m->observersMutex};
+        auto& v = m->observers;
+        v.erase(std::remove(v.begin(), v.end(), observer), v.end());
+        if (!v.empty()) {
+            ec = boost::system::error_code{};
+            return;
+        }
     }
-    else {
-        m->jointEventCallback = nullptr;
+    m->observerGranularity = 360.0;
+    m->syncObserverEvents(ec);
+}
+
+/* CLOCK SYNCHRONIZATION */
+
+void Linkbot::synchronizeClock (int rounds) {
+    auto ec = boost::system::error_code{};
+    synchronizeClock(rounds, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::synchronizeClock (int rounds, boost::system::error_code& ec) BOOST_NOEXCEPT {
+    // Sequential, uncoalesced round trips, so that each one is a clean sample.
+    ec = boost::system::error_code{};
+    for (int i = 0; i < rounds && !ec; ++i) {
+        MethodResult::getEncoderValues values;
+        auto sendTime = hostNow();
+        m->call(MethodIn::getEncoderValues{}, values, ec);
+        if (!ec) {
+            m->addClockSample(sendTime, hostNow(), values.timestamp);
+        }
     }
 }
 
-void Linkbot::setConnectionTerminatedCallback (ConnectionTerminatedCallback cb, void* userData) {
-    m->connectionTerminatedCallback = std::bind(cb, _1, userData);
+int64_t Linkbot::toHostTime (int timestamp) const {
+    std::lock_guard<std::mutex> lock{m->clockMutex};
+    return m->clock.valid() ? m->clock.toHost(timestamp) : 0;
 }
 
+bool Linkbot::getClockSync (double& driftPpm, double& uncertaintyMicroseconds) const {
+    std::lock_guard<std::mutex> lock{m->clockMutex};
+    if (!m->clock.valid()) {
+        return false;
+    }
+    driftPpm = m->clock.driftPpm();
+    uncertaintyMicroseconds = m->clock.uncertainty();
+    return true;
+}
 
 void Linkbot::writeEeprom(uint32_t address, const uint8_t *data, size_t size)
+{
+    auto ec = boost::system::error_code{};
+    writeEeprom(address, data, size, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::writeEeprom(uint32_t address, const uint8_t *data, size_t size,
+                          boost::system::error_code& ec) BOOST_NOEXCEPT
 {
     if(size > 128) {
-        throw Error("Payload size too large");
-    }
-    try {
-        MethodIn::writeEeprom arg;
-        arg.address = address;
-        memcpy(arg.data.bytes, data, size);
-        arg.data.size = size;
-        asyncFire(m->robot, arg, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
+        ec = make_error_code(boost::system::errc::message_size);
+        return;
+    }
+    MethodIn::writeEeprom arg;
+    arg.address = address;
+    memcpy(arg.data.bytes, data, size);
+    arg.data.size = size;
+    m->call(arg, ec);
+    if (address < kSerialIdAddress + kSerialIdSize && address + size > kSerialIdAddress) {
+        // Even a failed write may have changed it.
+        std::lock_guard<std::mutex> lock{m->identityMutex};
+        m->identity.hasSerialId = false;
     }
 }
 
 void Linkbot::readEeprom(uint32_t address, size_t recvsize, uint8_t *buffer)
+{
+    auto ec = boost::system::error_code{};
+    readEeprom(address, recvsize, buffer, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::readEeprom(uint32_t address, size_t recvsize, uint8_t *buffer,
+                         boost::system::error_code& ec) BOOST_NOEXCEPT
 {
     if(recvsize > 128) {
-        throw Error("Payload size too large");
-    }
-    try {
-        MethodIn::readEeprom arg;
-        arg.address = address;
-        arg.size = recvsize;
-        auto result = asyncFire(m->robot, arg, requestTimeout(), use_future).get();
+        ec = make_error_code(boost::system::errc::message_size);
+        return;
+    }
+    MethodIn::readEeprom arg;
+    arg.address = address;
+    arg.size = recvsize;
+    MethodResult::readEeprom result;
+    m->call(arg, result, ec);
+    if (!ec) {
         memcpy(buffer, result.data.bytes, result.data.size);
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
 }
 
 void Linkbot::writeTwi(uint32_t address, const uint8_t *data, size_t size)
+{
+    auto ec = boost::system::error_code{};
+    writeTwi(address, data, size, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::writeTwi(uint32_t address, const uint8_t *data, size_t size,
+                       boost::system::error_code& ec) BOOST_NOEXCEPT
 {
     if(size > 128) {
-        throw Error("Payload size too large");
-    }
-    try {
-        MethodIn::writeTwi arg;
-        arg.address = address;
-        memcpy(arg.data.bytes, data, size);
-        arg.data.size = size;
-        asyncFire(m->robot, arg, requestTimeout(), use_future).get();
-    }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
+        ec = make_error_code(boost::system::errc::message_size);
+        return;
+    }
+    MethodIn::writeTwi arg;
+    arg.address = address;
+    memcpy(arg.data.bytes, data, size);
+    arg.data.size = size;
+    m->call(arg, ec);
 }
 
 void Linkbot::readTwi(uint32_t address, size_t recvsize, uint8_t *buffer)
+{
+    auto ec = boost::system::error_code{};
+    readTwi(address, recvsize, buffer, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::readTwi(uint32_t address, size_t recvsize, uint8_t *buffer,
+                      boost::system::error_code& ec) BOOST_NOEXCEPT
 {
     if(recvsize > 128) {
-        throw Error("Payload size too large");
-    }
-    try {
-        MethodIn::readTwi arg;
-        arg.address = address;
-        arg.recvsize = recvsize;
-        auto result = asyncFire(m->robot, arg, requestTimeout(), use_future).get();
+        ec = make_error_code(boost::system::errc::message_size);
+        return;
+    }
+    MethodIn::readTwi arg;
+    arg.address = address;
+    arg.recvsize = recvsize;
+    MethodResult::readTwi result;
+    m->call(arg, result, ec);
+    if (!ec) {
         memcpy(buffer, result.data.bytes, result.data.size);
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
 }
 
 void Linkbot::writeReadTwi(
@@ -1053,22 +2483,34 @@ void Linkbot::writeReadTwi(
     size_t sendsize,
     uint8_t* recvbuf,
     size_t recvsize)
+{
+    auto ec = boost::system::error_code{};
+    writeReadTwi(address, sendbuf, sendsize, recvbuf, recvsize, ec);
+    throwIfError(ec);
+}
+
+void Linkbot::writeReadTwi(
+    uint32_t address,
+    const uint8_t *sendbuf,
+    size_t sendsize,
+    uint8_t* recvbuf,
+    size_t recvsize,
+    boost::system::error_code& ec) BOOST_NOEXCEPT
 {
     if((recvsize > 128) || (sendsize > 128)) {
-        throw Error("Payload size too large");
-    }
-    try {
-        MethodIn::writeReadTwi arg;
-        arg.address = address;
-        arg.recvsize = recvsize;
-        memcpy(arg.data.bytes, sendbuf, sendsize);
-        arg.data.size = sendsize;
-        auto result = asyncFire(m->robot, arg, requestTimeout(), use_future).get();
+        ec = make_error_code(boost::system::errc::message_size);
+        return;
+    }
+    MethodIn::writeReadTwi arg;
+    arg.address = address;
+    arg.recvsize = recvsize;
+    memcpy(arg.data.bytes, sendbuf, sendsize);
+    arg.data.size = sendsize;
+    MethodResult::writeReadTwi result;
+    m->call(arg, result, ec);
+    if (!ec) {
         memcpy(recvbuf, result.data.bytes, result.data.size);
     }
-    catch (std::exception& e) {
-        throw Error(e.what());
-    }
 }
 
 } // namespace
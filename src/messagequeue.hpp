@@ -0,0 +1,153 @@
+#ifndef BAROMESH_MESSAGEQUEUE_HPP
+#define BAROMESH_MESSAGEQUEUE_HPP
+
+#include "trace.hpp"
+
+#include <util/asio/asynccompletion.hpp>
+
+#include <sfp/asio/messagequeue.hpp>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace baromesh {
+
+// A message queue whose transport is chosen at run time. rpc::asio::Client
+// and Server are templated on their message queue; instantiating them on this
+// one lets the same client talk over a WebSocket, a framed local socket, or
+// anything else which models asyncSend/asyncReceive/close.
+//
+// The queue starts out unconnected. A connector emplace()s the concrete
+// queue it wants and sets it up before the RPC layer starts using it.
+class MessageQueue {
+public:
+    typedef void SendHandlerSignature(boost::system::error_code);
+    typedef void ReceiveHandlerSignature(boost::system::error_code, size_t);
+
+    explicit MessageQueue (boost::asio::io_service& ios) : mIos(ios) {}
+
+    // Replace the transport with a Queue constructed from our io_service and
+    // args, and return it.
+    template <class Queue, class... Args>
+    Queue& emplace (Args&&... args) {
+        auto model = std::unique_ptr<Model<Queue>>{
+            new Model<Queue>{mIos, std::forward<Args>(args)...}};
+        auto& queue = model->queue;
+        mBackend = std::move(model);
+        return queue;
+    }
+
+    template <class Handler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Handler, SendHandlerSignature)
+    asyncSend (boost::asio::const_buffer buffer, Handler&& handler) {
+        util::asio::AsyncCompletion<
+            Handler, SendHandlerSignature
+        > init { std::forward<Handler>(handler) };
+        if (mBackend && Tracer::global().enabled()) {
+            // Trace the write from when the RPC layer queued it until the
+            // transport finished with it.
+            auto begin = Tracer::now();
+            auto size = int64_t(boost::asio::buffer_size(buffer));
+            auto handler = init.handler;
+            mBackend->asyncSend(buffer, [handler, begin, size] (boost::system::error_code ec) mutable {
+                Tracer::global().span("write", "io", begin, Tracer::now(), "bytes", size);
+                handler(ec);
+            });
+        }
+        else if (mBackend) {
+            mBackend->asyncSend(buffer, init.handler);
+        }
+        else {
+            mIos.post(std::bind(init.handler, boost::asio::error::not_connected));
+        }
+        return init.result.get();
+    }
+
+    template <class Handler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(Handler, ReceiveHandlerSignature)
+    asyncReceive (boost::asio::mutable_buffer buffer, Handler&& handler) {
+        util::asio::AsyncCompletion<
+            Handler, ReceiveHandlerSignature
+        > init { std::forward<Handler>(handler) };
+        if (mBackend && Tracer::global().enabled()) {
+            auto handler = init.handler;
+            mBackend->asyncReceive(buffer, [handler] (boost::system::error_code ec, size_t size) mutable {
+                auto now = Tracer::now();
+                Tracer::global().span("receive", "io", now, now, "bytes", int64_t(size));
+                handler(ec, size);
+            });
+        }
+        else if (mBackend) {
+            mBackend->asyncReceive(buffer, init.handler);
+        }
+        else {
+            mIos.post(std::bind(init.handler, boost::asio::error::not_connected, size_t(0)));
+        }
+        return init.result.get();
+    }
+
+    void close () {
+        if (mBackend) {
+            mBackend->close();
+        }
+    }
+
+    boost::asio::io_service& get_io_service () {
+        return mIos;
+    }
+
+private:
+    struct Backend {
+        virtual ~Backend () {}
+        virtual void asyncSend (boost::asio::const_buffer,
+                                std::function<SendHandlerSignature>) = 0;
+        virtual void asyncReceive (boost::asio::mutable_buffer,
+                                   std::function<ReceiveHandlerSignature>) = 0;
+        virtual void close () = 0;
+    };
+
+    template <class Queue>
+    struct Model : Backend {
+        template <class... Args>
+        explicit Model (boost::asio::io_service& ios, Args&&... args)
+            : queue(ios, std::forward<Args>(args)...)
+        {}
+
+        virtual void asyncSend (boost::asio::const_buffer buffer,
+                                std::function<SendHandlerSignature> handler) {
+            queue.asyncSend(buffer, std::move(handler));
+        }
+
+        virtual void asyncReceive (boost::asio::mutable_buffer buffer,
+                                   std::function<ReceiveHandlerSignature> handler) {
+            queue.asyncReceive(buffer, std::move(handler));
+        }
+
+        virtual void close () {
+            queue.close();
+        }
+
+        Queue queue;
+    };
+
+    boost::asio::io_service& mIos;
+    std::unique_ptr<Backend> mBackend;
+};
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+// SFP-framed messages over a Unix-domain stream socket. This is the same
+// framing the robots speak over their serial links.
+using LocalMessageQueue = sfp::asio::MessageQueue<boost::asio::local::stream_protocol::socket>;
+
+#endif
+
+} // namespace baromesh
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef BAROMESH_REORDERBUFFER_HPP
+#define BAROMESH_REORDERBUFFER_HPP
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace baromesh {
+
+// A k-way merge of event streams into one stream ordered by time, with a
+// bounded reordering window.
+//
+// Each source's events are queued in the order it produced them, and a heap
+// over the queue heads yields the oldest. The oldest event is released once
+// every live source has produced an event at least as new, so nothing older
+// can still arrive, or once the clock has moved window past it, in which
+// case a source which has not kept up loses its chance. An event older than
+// one already released is late and dropped. Times are microseconds on any
+// clock the caller likes, as long as pop() is given the same one.
+template <class Event>
+class ReorderBuffer {
+public:
+    ReorderBuffer (int64_t window, size_t capacity)
+        : mWindow(window)
+        , mCapacity(capacity)
+    {}
+
+    size_t addSource () {
+        mSources.emplace_back();
+        mWatermarks.insert(mSources.back().watermark);
+        return mSources.size() - 1;
+    }
+
+    // Stop waiting for source. Its queued events are still released.
+    void removeSource (size_t source) {
+        auto& s = mSources[source];
+        if (s.live) {
+            mWatermarks.erase(mWatermarks.find(s.watermark));
+            s.live = false;
+        }
+    }
+
+    // Queue an event which source produced at time. A source's events are
+    // kept in order: one older than its predecessor is treated as
+    // simultaneous with it. Returns false if the event was dropped, because
+    // it is late or the buffer is full.
+    bool push (size_t source, int64_t time, const Event& event) {
+        auto& s = mSources[source];
+        if (!s.live) {
+            return false;
+        }
+        time = std::max(time, s.watermark);
+        if (time < mReleased) {
+            ++mLate;
+            return false;
+        }
+        if (mSize == mCapacity) {
+            ++mOverflowed;
+            return false;
+        }
+        if (time != s.watermark) {
+            mWatermarks.erase(mWatermarks.find(s.watermark));
+            mWatermarks.insert(time);
+            s.watermark = time;
+        }
+        if (s.queue.empty()) {
+            mHeads.push(Head{time, source});
+        }
+        s.queue.emplace_back(time, event);
+        ++mSize;
+        return true;
+    }
+
+    // If the oldest event may be released at time now, move it into event and
+    // its time into time.
+    bool pop (int64_t now, Event& event, int64_t& time) {
+        if (mHeads.empty() || now < deadline()) {
+            return false;
+        }
+        auto head = mHeads.top();
+        mHeads.pop();
+        auto& q = mSources[head.source].queue;
+        time = q.front().first;
+        event = std::move(q.front().second);
+        q.pop_front();
+        if (!q.empty()) {
+            mHeads.push(Head{q.front().first, head.source});
+        }
+        --mSize;
+        mReleased = time;
+        return true;
+    }
+
+    // The earliest time at which pop() will succeed without any more pushes:
+    // the minimum if the oldest event is ready now, the maximum if the buffer
+    // is empty.
+    int64_t deadline () const {
+        if (mHeads.empty()) {
+            return std::numeric_limits<int64_t>::max();
+        }
+        auto t = mHeads.top().time;
+        if (mWatermarks.empty() || *mWatermarks.begin() >= t) {
+            return std::numeric_limits<int64_t>::min();
+        }
+        return t + mWindow;
+    }
+
+    size_t size () const { return mSize; }
+    uint64_t late () const { return mLate; }
+    uint64_t overflowed () const { return mOverflowed; }
+
+private:
+    struct Source {
+        std::deque<std::pair<int64_t, Event>> queue;
+        int64_t watermark = std::numeric_limits<int64_t>::min();  // newest event's time
+        bool live = true;
+    };
+
+    struct Head {
+        int64_t time;
+        size_t source;
+        bool operator> (const Head& other) const {
+            return time > other.time || (time == other.time && source > other.source);
+        }
+    };
+
+    int64_t mWindow;
+    size_t mCapacity;
+    std::vector<Source> mSources;
+    std::multiset<int64_t> mWatermarks;  // of the live sources
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> mHeads;
+    size_t mSize = 0;
+    int64_t mReleased = std::numeric_limits<int64_t>::min();
+    uint64_t mLate = 0;
+    uint64_t mOverflowed = 0;
+};
+
+} // namespace baromesh
+
+#endif
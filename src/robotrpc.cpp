@@ -0,0 +1,13 @@
+#include "robotrpc.hpp"
+
+namespace baromesh {
+
+#define BAROMESH_INSTANTIATE_GETTER(method) \
+    BAROMESH_ROBOT_RPC(, RobotMethodResult::method, method)
+#define BAROMESH_INSTANTIATE_SETTER(method) \
+    BAROMESH_ROBOT_RPC(, IgnoredResult, method)
+
+BAROMESH_ROBOT_GETTERS(BAROMESH_INSTANTIATE_GETTER)
+BAROMESH_ROBOT_SETTERS(BAROMESH_INSTANTIATE_SETTER)
+
+} // namespace baromesh
@@ -0,0 +1,100 @@
+#ifndef BAROMESH_ROBOTRPC_HPP
+#define BAROMESH_ROBOTRPC_HPP
+
+#include "websocketclient.hpp"
+
+#include "gen-robot.pb.hpp"
+
+#include <boost/system/error_code.hpp>
+
+#include <chrono>
+
+namespace baromesh {
+
+using RobotMethodIn = rpc::MethodIn<barobo::Robot>;
+using RobotMethodResult = rpc::MethodResult<barobo::Robot>;
+
+// Stand-in result for RPCs whose reply carries nothing we need.
+struct IgnoredResult {
+    IgnoredResult () = default;
+    template <class T>
+    IgnoredResult (const T&) {}
+};
+
+// The one completion handler type for robot RPCs: a function and a context
+// pointer, which the caller keeps alive until the function has been called.
+// Copying it allocates nothing.
+template <class Result>
+struct RobotHandler {
+    void (*complete)(void* context, boost::system::error_code ec, const Result& result);
+    void* context;
+
+    void operator() (boost::system::error_code ec, const Result& result) const {
+        complete(context, ec, result);
+    }
+};
+
+// asyncFire with a fixed handler type, so that the RPC client's composed
+// operation is instantiated once per method and result type rather than once
+// per call site. The methods Linkbot uses are instantiated in robotrpc.cpp;
+// see BAROMESH_ROBOT_GETTERS below.
+template <class Result, class Method>
+void asyncFireRobot (WebSocketClient& robot, const Method& args,
+                     std::chrono::milliseconds timeout, RobotHandler<Result> handler) {
+    rpc::asio::asyncFire(robot, args, timeout, handler);
+}
+
+// Methods whose result Linkbot reads.
+#define BAROMESH_ROBOT_GETTERS(X) \
+    X(getAccelerometerData) \
+    X(getAdcRaw) \
+    X(getBatteryVoltage) \
+    X(getEncoderValues) \
+    X(getFirmwareVersion) \
+    X(getFormFactor) \
+    X(getJointStates) \
+    X(getLedColor) \
+    X(getMotorControllerOmega) \
+    X(getMotorControllerSafetyAngle) \
+    X(getMotorControllerSafetyThreshold) \
+    X(readEeprom) \
+    X(readTwi) \
+    X(writeReadTwi)
+
+// Methods whose result Linkbot ignores.
+#define BAROMESH_ROBOT_SETTERS(X) \
+    X(enableAccelerometerEvent) \
+    X(enableButtonEvent) \
+    X(enableEncoderEvent) \
+    X(enableJointEvent) \
+    X(move) \
+    X(resetEncoderRevs) \
+    X(setBuzzerFrequency) \
+    X(setLedColor) \
+    X(setMotorControllerAlphaF) \
+    X(setMotorControllerAlphaI) \
+    X(setMotorControllerOmega) \
+    X(setMotorControllerSafetyAngle) \
+    X(setMotorControllerSafetyThreshold) \
+    X(stop) \
+    X(writeEeprom) \
+    X(writeTwi)
+
+#define BAROMESH_ROBOT_RPC(Extern, Result, method) \
+    Extern template void asyncFireRobot<Result, RobotMethodIn::method> ( \
+        WebSocketClient&, const RobotMethodIn::method&, \
+        std::chrono::milliseconds, RobotHandler<Result>);
+#define BAROMESH_EXTERN_GETTER(method) \
+    BAROMESH_ROBOT_RPC(extern, RobotMethodResult::method, method)
+#define BAROMESH_EXTERN_SETTER(method) \
+    BAROMESH_ROBOT_RPC(extern, IgnoredResult, method)
+
+BAROMESH_ROBOT_GETTERS(BAROMESH_EXTERN_GETTER)
+BAROMESH_ROBOT_SETTERS(BAROMESH_EXTERN_SETTER)
+
+#undef BAROMESH_EXTERN_GETTER
+#undef BAROMESH_EXTERN_SETTER
+
+} // namespace baromesh
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef BAROMESH_SEQLOCK_HPP
+#define BAROMESH_SEQLOCK_HPP
+
+#include <atomic>
+
+#include <cstring>
+
+#include <stdint.h>
+
+namespace baromesh {
+
+// A sequence lock over a plain-old-data value, laid out so that it can live
+// in memory shared between processes. The sequence number is odd while the
+// writer is writing; readers copy the value and accept the copy only if the
+// sequence number was even and unchanged around it. The writer never waits,
+// and readers retry only if they race with a write.
+//
+// Zero-filled memory is a valid, unwritten SeqLock. Writers must serialize
+// among themselves.
+template <class T>
+class SeqLock {
+public:
+    template <class Update>
+    void write (Update&& update) {
+        auto seq = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        update(mValue);
+        mSequence.store(seq + 2, std::memory_order_release);
+    }
+
+    void read (T& value) const {
+        for (;;) {
+            auto before = mSequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            memcpy(&value, &mValue, sizeof(value));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mSequence.load(std::memory_order_relaxed) == before) {
+                return;
+            }
+        }
+    }
+
+    // Number of writes so far.
+    uint64_t version () const {
+        return mSequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    std::atomic<uint64_t> mSequence;
+    T mValue;
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+    "seqlock counter must be a plain 64-bit word to be shared across processes");
+
+} // namespace baromesh
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef BAROMESH_SHADOWSTATE_HPP
+#define BAROMESH_SHADOWSTATE_HPP
+
+#include "latestwins.hpp"
+
+#include <mutex>
+
+namespace baromesh {
+
+template <class T>
+bool covers (const T& shadow, const T& value) {
+    return shadow == value;
+}
+
+// A per-joint shadow covers a value if it knows every joint the value's mask
+// addresses, and they are all equal.
+inline bool covers (const JointValues& shadow, const JointValues& value) {
+    if (value.mask & ~shadow.mask) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        if ((value.mask & (1 << i)) && shadow.values[i] != value.values[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The last value of a robot setting which the robot acknowledged. Lets a
+// setter skip its request when it would not change anything.
+template <class Value>
+class Shadow {
+public:
+    // True if sending value would leave the robot's setting unchanged.
+    bool covers (const Value& value) const {
+        std::lock_guard<std::mutex> lock{mMutex};
+        return mValid && baromesh::covers(mValue, value);
+    }
+
+    // Record that the robot acknowledged value.
+    void update (const Value& value) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        if (mValid) {
+            coalesce(mValue, value);
+        }
+        else {
+            mValue = value;
+            mValid = true;
+        }
+    }
+
+    void invalidate () {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mValid = false;
+    }
+
+private:
+    mutable std::mutex mMutex;
+    bool mValid = false;
+    Value mValue;
+};
+
+} // namespace baromesh
+
+#endif
@@ -0,0 +1,239 @@
+#include <baromesh/sharedstate.hpp>
+#include <baromesh/error.hpp>
+
+#include "seqlock.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace barobo {
+
+namespace {
+
+const uint32_t kMagic = 0x4c4b4253; // "LKBS"
+
+// Layout of the shared-memory region. owner is the exporting process, so that
+// a region left behind by one which died can be recognized and replaced.
+struct Region {
+    uint32_t magic;
+    uint32_t size;
+    int32_t owner;
+    baromesh::SeqLock<SharedRobotState> state;
+};
+
+std::string regionName (const std::string& name) {
+    return "/baromesh-" + name;
+}
+
+} // file namespace
+
+#ifndef _WIN32
+
+struct SharedStateExporter::Impl : StateObserver {
+    Impl (Linkbot& l, const std::string& n) : linkbot(l), name(regionName(n)) {
+        // Never adopt a region someone else created: its contents and size
+        // are theirs, and unlinking it on exit would pull it from under them.
+        // A region whose exporter died is replaced, once.
+        auto fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (-1 == fd && EEXIST == errno && unlinkIfStale()) {
+            fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        }
+        if (-1 == fd && EEXIST == errno) {
+            throw Error("shm_open " + name + ": name already taken by another exporter");
+        }
+        if (-1 == fd) {
+            throw Error("shm_open " + name + ": " + strerror(errno));
+        }
+        if (-1 == ftruncate(fd, sizeof(Region))) {
+            auto e = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            throw Error("ftruncate " + name + ": " + strerror(e));
+        }
+        auto p = mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == p) {
+            shm_unlink(name.c_str());
+            throw Error("mmap " + name + ": " + strerror(errno));
+        }
+        memset(p, 0, sizeof(Region));
+        region = static_cast<Region*>(p);
+        region->size = sizeof(Region);
+        region->owner = int32_t(getpid());
+        region->magic = kMagic;
+    }
+
+    // Unlink the existing region of our name if it is a complete one whose
+    // exporter no longer runs. Anything else, including a region which is
+    // still being set up, counts as taken.
+    bool unlinkIfStale () {
+        auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (-1 == fd) {
+            return ENOENT == errno;
+        }
+        struct stat st;
+        auto p = MAP_FAILED;
+        if (0 == fstat(fd, &st) && size_t(st.st_size) >= sizeof(Region)) {
+            p = mmap(nullptr, sizeof(Region), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (MAP_FAILED == p) {
+            return false;
+        }
+        auto existing = static_cast<const Region*>(p);
+        auto stale = kMagic == existing->magic && existing->owner > 0
+            && -1 == kill(pid_t(existing->owner), 0) && ESRCH == errno;
+        munmap(p, sizeof(Region));
+        return stale && 0 == shm_unlink(name.c_str());
+    }
+
+    ~Impl () {
+        munmap(region, sizeof(Region));
+        shm_unlink(name.c_str());
+    }
+
+    // Observers are notified from both the I/O thread (events) and caller
+    // threads (getters), so writers serialize among themselves. Readers never
+    // take the lock.
+    template <class Update>
+    void write (Update&& update) {
+        std::lock_guard<std::mutex> lock{writeMutex};
+        region->state.write(std::forward<Update>(update));
+    }
+
+    virtual void onJointAngle (int joint, double degrees, int timestamp, int64_t hostTime) {
+        if (joint < 0 || joint >= 3) { return; }
+        write([&] (SharedRobotState& s) {
+            s.jointAngles[joint] = degrees;
+            s.jointAnglesTimestamp[joint] = timestamp;
+            s.jointAnglesHostTime[joint] = hostTime;
+        });
+    }
+
+    virtual void onJointState (int joint, JointState::Type state, int, int64_t hostTime) {
+        if (joint < 0 || joint >= 3) { return; }
+        write([&] (SharedRobotState& s) {
+            s.jointStates[joint] = state;
+            s.jointStatesHostTime[joint] = hostTime;
+        });
+    }
+
+    virtual void onAccelerometer (double x, double y, double z, int timestamp, int64_t hostTime) {
+        write([&] (SharedRobotState& s) {
+            s.accelerometer[0] = x;
+            s.accelerometer[1] = y;
+            s.accelerometer[2] = z;
+            s.accelerometerTimestamp = timestamp;
+            s.accelerometerHostTime = hostTime;
+        });
+    }
+
+    virtual void onBatteryVoltage (double volts, int64_t hostTime) {
+        write([&] (SharedRobotState& s) {
+            s.batteryVoltage = volts;
+            s.batteryVoltageHostTime = hostTime;
+        });
+    }
+
+    Linkbot& linkbot;
+    std::string name;
+    Region* region;
+    std::mutex writeMutex;
+};
+
+SharedStateExporter::SharedStateExporter (Linkbot& linkbot, const std::string& name,
+                                          double encoderGranularity)
+    : m(new Impl(linkbot, name))
+{
+    try {
+        linkbot.addStateObserver(m, encoderGranularity);
+    }
+    catch (...) {
+        delete m;
+        throw;
+    }
+}
+
+SharedStateExporter::~SharedStateExporter () {
+    auto ec = boost::system::error_code{};
+    m->linkbot.removeStateObserver(m, ec);
+    delete m;
+}
+
+struct SharedStateReader::Impl {
+    explicit Impl (const std::string& n) : name(regionName(n)) {
+        auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (-1 == fd) {
+            throw Error("shm_open " + name + ": " + strerror(errno));
+        }
+        auto p = mmap(nullptr, sizeof(Region), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == p) {
+            throw Error("mmap " + name + ": " + strerror(errno));
+        }
+        region = static_cast<const Region*>(p);
+        if (region->magic != kMagic || region->size != sizeof(Region)) {
+            munmap(const_cast<Region*>(region), sizeof(Region));
+            throw Error(name + ": not a baromesh shared state region");
+        }
+    }
+
+    ~Impl () {
+        munmap(const_cast<Region*>(region), sizeof(Region));
+    }
+
+    std::string name;
+    const Region* region;
+};
+
+SharedStateReader::SharedStateReader (const std::string& name)
+    : m(new Impl(name))
+{}
+
+SharedStateReader::~SharedStateReader () {
+    delete m;
+}
+
+void SharedStateReader::read (SharedRobotState& state) const {
+    m->region->state.read(state);
+}
+
+uint64_t SharedStateReader::version () const {
+    return m->region->state.version();
+}
+
+#else // _WIN32
+
+struct SharedStateExporter::Impl {};
+struct SharedStateReader::Impl {};
+
+SharedStateExporter::SharedStateExporter (Linkbot&, const std::string&, double) : m(nullptr) {
+    throw Error("SharedStateExporter requires POSIX shared memory");
+}
+
+SharedStateExporter::~SharedStateExporter () {}
+
+SharedStateReader::SharedStateReader (const std::string&) : m(nullptr) {
+    throw Error("SharedStateReader requires POSIX shared memory");
+}
+
+SharedStateReader::~SharedStateReader () {}
+
+void SharedStateReader::read (SharedRobotState&) const {}
+
+uint64_t SharedStateReader::version () const { return 0; }
+
+#endif
+
+} // namespace barobo
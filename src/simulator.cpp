@@ -0,0 +1,536 @@
+#include "endpoint.hpp"
+#include "inproc.hpp"
+#include "iopool.hpp"
+#include "jointmodel.hpp"
+#include "messagequeue.hpp"
+
+#include <baromesh/simulator.hpp>
+#include <baromesh/error.hpp>
+
+#include "gen-robot.pb.hpp"
+
+#include <rpc/asio/server.hpp>
+
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <boost/log/sources/logger.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace barobo {
+
+namespace {
+
+using MethodIn = rpc::MethodIn<barobo::Robot>;
+using MethodResult = rpc::MethodResult<barobo::Robot>;
+using Broadcast = rpc::Broadcast<barobo::Robot>;
+using Server = rpc::asio::Server<baromesh::MessageQueue>;
+
+// Joints are stepped, and encoder events generated, at this interval while
+// any joint is moving. Real robots report encoder events at a similar rate.
+const auto kTick = std::chrono::milliseconds{10};
+
+// Where Linkbot::getSerialId() finds the serial ID.
+const uint32_t kSerialIdAddress = 0x412;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+// Remove a socket left at path, e.g., by an earlier simulator. Throws if
+// something other than a socket is there, rather than delete a user's file.
+void removeSocket (const std::string& path) {
+    struct stat st;
+    if (-1 == lstat(path.c_str(), &st)) {
+        return;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        throw Error(path + " exists and is not a socket");
+    }
+    unlink(path.c_str());
+}
+#endif
+
+class SimulatedRobot;
+
+// One connected client.
+struct Session : std::enable_shared_from_this<Session> {
+    Session (std::shared_ptr<SimulatedRobot> r, boost::asio::io_service& ios)
+        : robot(std::move(r)), server(ios) {}
+
+    template <class In>
+    void onFire (const In& args, rpc::asio::RequestId requestId);
+
+    std::shared_ptr<SimulatedRobot> robot;
+    Server server;
+};
+
+// The robot's state and its server. Everything runs on the robot's I/O
+// thread, so nothing here needs a lock.
+class SimulatedRobot : public std::enable_shared_from_this<SimulatedRobot> {
+public:
+    SimulatedRobot (boost::asio::io_service& ios, const std::string& endpoint,
+                    const std::string& serialId, FormFactor::Type formFactor)
+        : mIos(ios)
+        , mTimer(ios)
+        , mEpoch(std::chrono::steady_clock::now())
+        , mFormFactor(formFactor)
+    {
+        memset(mEeprom, 0, sizeof(mEeprom));
+        memcpy(mEeprom + kSerialIdAddress, serialId.data(), std::min<size_t>(4, serialId.size()));
+
+        if (baromesh::isInprocEndpoint(endpoint)) {
+            mListener.reset(new baromesh::inproc::Listener{ios,
+                baromesh::inprocEndpointName(endpoint)});
+        }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        else if (baromesh::isUnixEndpoint(endpoint)) {
+            mPath = baromesh::unixEndpointPath(endpoint);
+            removeSocket(mPath);
+            boost::asio::local::stream_protocol::endpoint ep{mPath};
+            mAcceptor.reset(new boost::asio::local::stream_protocol::acceptor{ios});
+            mAcceptor->open(ep.protocol());
+            mAcceptor->bind(ep);
+            mAcceptor->listen();
+        }
+#endif
+        else {
+            throw Error("Simulator cannot serve at " + endpoint);
+        }
+    }
+
+    void start () {
+        auto self = shared_from_this();
+        mIos.post([self] { self->accept(); });
+    }
+
+    // Close the listener and every client. Call on the I/O thread.
+    void stop () {
+        auto ec = boost::system::error_code{};
+        mListener.reset();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (mAcceptor) {
+            mAcceptor->close(ec);
+            try {
+                removeSocket(mPath);
+            }
+            catch (Error&) {
+                // Someone replaced our socket; leave their file be.
+            }
+        }
+#endif
+        mTimer.cancel(ec);
+        for (auto& session : mSessions) {
+            session->server.close();
+        }
+        mSessions.clear();
+    }
+
+    // Requests. Anything not modeled succeeds with an empty reply.
+    template <class In>
+    typename rpc::ResultOf<In>::type handle (const In&) {
+        return {};
+    }
+
+    MethodResult::getEncoderValues handle (const MethodIn::getEncoderValues&) {
+        auto result = MethodResult::getEncoderValues{};
+        result.values_count = 3;
+        for (int i = 0; i < 3; ++i) {
+            result.values[i] = float(mJoints[i].angle);
+        }
+        result.timestamp = now();
+        return result;
+    }
+
+    MethodResult::getJointStates handle (const MethodIn::getJointStates&) {
+        auto result = MethodResult::getJointStates{};
+        result.values_count = 3;
+        using Value = std::decay<decltype(result.values[0])>::type;
+        for (int i = 0; i < 3; ++i) {
+            result.values[i] = static_cast<Value>(mJoints[i].state);
+        }
+        // Like the robot, leave the timestamp unset; see Linkbot::getJointStates.
+        return result;
+    }
+
+    MethodResult::getMotorControllerOmega handle (const MethodIn::getMotorControllerOmega&) {
+        auto result = MethodResult::getMotorControllerOmega{};
+        result.values_count = 3;
+        for (int i = 0; i < 3; ++i) {
+            result.values[i] = float(mJoints[i].speed);
+        }
+        return result;
+    }
+
+    MethodResult::setMotorControllerOmega handle (const MethodIn::setMotorControllerOmega& args) {
+        auto n = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (args.mask & (1 << i) && n < int(args.values_count)) {
+                mJoints[i].speed = std::min(double(std::abs(args.values[n++])),
+                                            baromesh::JointModel::maxSpeed());
+            }
+        }
+        return {};
+    }
+
+    MethodResult::move handle (const MethodIn::move& args) {
+        if (args.has_motorOneGoal) { setGoal(0, args.motorOneGoal); }
+        if (args.has_motorTwoGoal) { setGoal(1, args.motorTwoGoal); }
+        if (args.has_motorThreeGoal) { setGoal(2, args.motorThreeGoal); }
+        return {};
+    }
+
+    MethodResult::stop handle (const MethodIn::stop& args) {
+        auto mask = args.has_mask ? args.mask : 0x07;
+        for (int i = 0; i < 3; ++i) {
+            if (mask & (1 << i)) {
+                setState(i, JointState::COAST);
+            }
+        }
+        return {};
+    }
+
+    MethodResult::resetEncoderRevs handle (const MethodIn::resetEncoderRevs&) {
+        for (auto& j : mJoints) {
+            j.angle = std::remainder(j.angle, baromesh::JointModel::radians(360));
+        }
+        return {};
+    }
+
+    MethodResult::getAccelerometerData handle (const MethodIn::getAccelerometerData&) {
+        auto result = MethodResult::getAccelerometerData{};
+        result.z = 1;
+        return result;
+    }
+
+    MethodResult::getBatteryVoltage handle (const MethodIn::getBatteryVoltage&) {
+        auto result = MethodResult::getBatteryVoltage{};
+        result.v = 4.1f;
+        return result;
+    }
+
+    MethodResult::getFormFactor handle (const MethodIn::getFormFactor&) {
+        auto result = MethodResult::getFormFactor{};
+        result.value = static_cast<decltype(result.value)>(mFormFactor);
+        return result;
+    }
+
+    MethodResult::getLedColor handle (const MethodIn::getLedColor&) {
+        auto result = MethodResult::getLedColor{};
+        result.value = mLedColor;
+        return result;
+    }
+
+    MethodResult::setLedColor handle (const MethodIn::setLedColor& args) {
+        mLedColor = args.value;
+        return {};
+    }
+
+    MethodResult::readEeprom handle (const MethodIn::readEeprom& args) {
+        auto result = MethodResult::readEeprom{};
+        auto size = std::min<size_t>(args.size, sizeof(result.data.bytes));
+        if (args.address < sizeof(mEeprom) && size <= sizeof(mEeprom) - args.address) {
+            memcpy(result.data.bytes, mEeprom + args.address, size);
+            result.data.size = size;
+        }
+        return result;
+    }
+
+    MethodResult::writeEeprom handle (const MethodIn::writeEeprom& args) {
+        auto size = size_t(args.data.size);
+        if (args.address < sizeof(mEeprom) && size <= sizeof(mEeprom) - args.address) {
+            memcpy(mEeprom + args.address, args.data.bytes, size);
+        }
+        return {};
+    }
+
+    MethodResult::enableEncoderEvent handle (const MethodIn::enableEncoderEvent& args) {
+        if (args.has_encoderOne) { subscribeEncoder(0, args.encoderOne); }
+        if (args.has_encoderTwo) { subscribeEncoder(1, args.encoderTwo); }
+        if (args.has_encoderThree) { subscribeEncoder(2, args.encoderThree); }
+        return {};
+    }
+
+    MethodResult::enableJointEvent handle (const MethodIn::enableJointEvent& args) {
+        mJointEvents = args.enable;
+        return {};
+    }
+
+    template <class Result>
+    void reply (Session& session, rpc::asio::RequestId requestId, const Result& result) {
+        auto self = shared_from_this();
+        rpc::asio::asyncReply(session.server, requestId, result,
+            [self] (boost::system::error_code ec) {
+                if (ec) {
+                    BOOST_LOG(self->mLog) << "Error replying: " << ec.message();
+                }
+            });
+    }
+
+private:
+    template <class Goal>
+    void setGoal (int i, const Goal& goal) {
+        auto& j = mJoints[i];
+        auto uses = [&goal] (decltype(goal.controller) controller) {
+            return goal.has_controller && controller == goal.controller;
+        };
+        switch (goal.type) {
+            case barobo_Robot_Goal_Type_ABSOLUTE:
+            case barobo_Robot_Goal_Type_RELATIVE: {
+                auto base = barobo_Robot_Goal_Type_RELATIVE == goal.type ? j.angle : 0.0;
+                if (uses(barobo_Robot_Goal_Controller_ACCEL)) {
+                    // moveAccel: the goal is an acceleration.
+                    j.accelerate(goal.goal);
+                }
+                else {
+                    j.moveTo(base + goal.goal, uses(barobo_Robot_Goal_Controller_SMOOTH));
+                }
+                break;
+            }
+            case barobo_Robot_Goal_Type_INFINITE:
+                if (uses(barobo_Robot_Goal_Controller_PID)) {
+                    // motorPower: the goal is a PWM duty cycle out of 255, and
+                    // no power lets the joint coast.
+                    j.moveAt(goal.goal / 255.0 * baromesh::JointModel::maxSpeed());
+                }
+                else {
+                    // moveContinuous: the goal scales the joint speed, and a
+                    // speed of zero holds the joint where it is.
+                    j.moveAt(goal.goal * j.speed, JointState::HOLD);
+                }
+                break;
+            default:
+                break;
+        }
+        if (goal.has_timeout) {
+            auto end = goal.has_modeOnTimeout ? static_cast<JointState::Type>(goal.modeOnTimeout)
+                                              : JointState::HOLD;
+            j.setTimeout(goal.timeout, end);
+        }
+        jointEvent(i);
+        tick();
+    }
+
+    void setState (int i, JointState::Type state) {
+        auto changed = mJoints[i].state != state;
+        mJoints[i].stop(state);
+        if (changed) {
+            jointEvent(i);
+        }
+    }
+
+    template <class Granularity>
+    void subscribeEncoder (int i, const Granularity& g) {
+        mEncoderGranularity[i] = g.enable ? std::max(double(g.granularity), 1e-4) : 0;
+        mEncoderReported[i] = mJoints[i].angle;
+    }
+
+    // Step the joints and schedule the next tick while anything moves.
+    void tick () {
+        if (mTicking) {
+            return;
+        }
+        mTicking = true;
+        mLastTick = std::chrono::steady_clock::now();
+        scheduleTick();
+    }
+
+    void scheduleTick () {
+        auto self = shared_from_this();
+        mTimer.expires_from_now(kTick);
+        mTimer.async_wait([self] (boost::system::error_code ec) {
+            if (ec) {
+                self->mTicking = false;
+                return;
+            }
+            self->step();
+        });
+    }
+
+    void step () {
+        auto now = std::chrono::steady_clock::now();
+        auto dt = std::chrono::duration<double>(now - mLastTick).count();
+        mLastTick = now;
+        auto moving = false;
+        for (int i = 0; i < 3; ++i) {
+            auto& j = mJoints[i];
+            if (j.step(dt)) {
+                jointEvent(i);
+            }
+            encoderEvent(i);
+            moving = moving || JointState::MOVING == j.state;
+        }
+        if (moving) {
+            scheduleTick();
+        }
+        else {
+            mTicking = false;
+        }
+    }
+
+    void encoderEvent (int i) {
+        auto granularity = mEncoderGranularity[i];
+        auto angle = mJoints[i].angle;
+        if (granularity > 0 && std::abs(angle - mEncoderReported[i]) >= granularity) {
+            mEncoderReported[i] = angle;
+            auto b = Broadcast::encoderEvent{};
+            b.encoder = i;
+            b.value = float(angle);
+            b.timestamp = now();
+            broadcast(b);
+        }
+    }
+
+    void jointEvent (int i) {
+        if (mJointEvents) {
+            auto b = Broadcast::jointEvent{};
+            b.joint = i;
+            b.event = static_cast<decltype(b.event)>(mJoints[i].state);
+            b.timestamp = now();
+            broadcast(b);
+        }
+    }
+
+    template <class B>
+    void broadcast (const B& b) {
+        auto self = shared_from_this();
+        for (auto& session : mSessions) {
+            rpc::asio::asyncBroadcast(session->server, b,
+                [self] (boost::system::error_code ec) {
+                    if (ec) {
+                        BOOST_LOG(self->mLog) << "Error broadcasting: " << ec.message();
+                    }
+                });
+        }
+    }
+
+    // Robot clock: milliseconds since the simulator started.
+    uint32_t now () const {
+        using namespace std::chrono;
+        return uint32_t(duration_cast<milliseconds>(steady_clock::now() - mEpoch).count());
+    }
+
+    void accept () {
+        auto self = shared_from_this();
+        auto session = std::make_shared<Session>(self, mIos);
+        if (mListener) {
+            auto& mq = session->server.messageQueue().emplace<baromesh::inproc::MessageQueue>();
+            mListener->asyncAccept(mq, [self, session] (boost::system::error_code ec) {
+                if (!ec) {
+                    self->accept();
+                    self->serve(session);
+                }
+            });
+        }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        else if (mAcceptor) {
+            auto& mq = session->server.messageQueue().emplace<baromesh::LocalMessageQueue>();
+            mAcceptor->async_accept(mq.stream(), [self, session, &mq] (boost::system::error_code ec) {
+                if (ec) {
+                    return;
+                }
+                self->accept();
+                mq.asyncHandshake([self, session] (boost::system::error_code ec) {
+                    if (!ec) {
+                        self->serve(session);
+                    }
+                });
+            });
+        }
+#endif
+    }
+
+    void serve (std::shared_ptr<Session> session) {
+        mSessions.push_back(session);
+        auto self = shared_from_this();
+        rpc::asio::asyncRunServer<barobo::Robot>(session->server, *session,
+            [self, session] (boost::system::error_code ec) {
+                BOOST_LOG(self->mLog) << "Simulator client disconnected: " << ec.message();
+                self->mSessions.remove(session);
+            });
+    }
+
+    mutable boost::log::sources::logger mLog;
+    boost::asio::io_service& mIos;
+
+    std::unique_ptr<baromesh::inproc::Listener> mListener;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    std::unique_ptr<boost::asio::local::stream_protocol::acceptor> mAcceptor;
+#endif
+    std::string mPath;
+    std::list<std::shared_ptr<Session>> mSessions;
+
+    boost::asio::steady_timer mTimer;
+    bool mTicking = false;
+    std::chrono::steady_clock::time_point mLastTick;
+    std::chrono::steady_clock::time_point mEpoch;
+
+    baromesh::JointModel mJoints[3];
+    double mEncoderGranularity[3] = { 0, 0, 0 };  // radians; 0 is off
+    double mEncoderReported[3] = { 0, 0, 0 };
+    bool mJointEvents = false;
+
+    FormFactor::Type mFormFactor;
+    uint32_t mLedColor = 0x0000ff;
+    uint8_t mEeprom[2048];
+};
+
+template <class In>
+void Session::onFire (const In& args, rpc::asio::RequestId requestId) {
+    robot->reply(*this, requestId, robot->handle(args));
+}
+
+} // file namespace
+
+struct Simulator::Impl {
+    Impl (const std::string& e, const std::string& serialId, FormFactor::Type formFactor)
+        : endpoint(e)
+        , robot(std::make_shared<SimulatedRobot>(io.context(), e, serialId, formFactor))
+    {
+        robot->start();
+    }
+
+    ~Impl () {
+        auto stopped = std::promise<void>{};
+        auto r = robot;
+        io.context().post([r, &stopped] {
+            r->stop();
+            stopped.set_value();
+        });
+        stopped.get_future().wait();
+    }
+
+    baromesh::IoLease io;
+    std::string endpoint;
+    std::shared_ptr<SimulatedRobot> robot;
+};
+
+Simulator::Simulator (const std::string& endpoint, const std::string& serialId,
+                      FormFactor::Type formFactor) try
+    : m(new Impl{endpoint, serialId, formFactor})
+{}
+catch (std::exception& e) {
+    throw Error(endpoint + ": " + e.what());
+}
+
+Simulator::~Simulator () {
+    delete m;
+}
+
+const std::string& Simulator::endpoint () const {
+    return m->endpoint;
+}
+
+} // namespace barobo
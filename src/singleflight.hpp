@@ -0,0 +1,77 @@
+#ifndef BAROMESH_SINGLEFLIGHT_HPP
+#define BAROMESH_SINGLEFLIGHT_HPP
+
+#include "waiter.hpp"
+
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <stdint.h>
+
+namespace baromesh {
+
+// Collapses concurrent identical requests into one. The first caller to
+// join() while nothing is in flight becomes the leader and must send the
+// request, then pass its outcome to complete(). Callers which join() while the
+// request is outstanding just wait for that outcome, including when the
+// request was sent.
+template <class Result>
+class SingleFlight {
+public:
+    struct Caller {
+        Waiter* waiter;
+        Result* result;
+        boost::system::error_code* status;
+        int64_t* sent;  // may be null
+    };
+
+    // Register a caller whose waiter is already armed. Returns true if the
+    // caller is the leader.
+    bool join (Caller caller) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        mCallers.push_back(caller);
+        if (mInFlight) {
+            ++mSaved;
+            return false;
+        }
+        mInFlight = true;
+        ++mSent;
+        return true;
+    }
+
+    // Deliver the outcome, and the host time at which the leader sent the
+    // request, to every caller which joined this flight.
+    void complete (boost::system::error_code ec, const Result& result, int64_t sent) {
+        std::lock_guard<std::mutex> lock{mMutex};
+        for (auto& caller : mCallers) {
+            if (!ec) {
+                *caller.result = result;
+            }
+            *caller.status = ec;
+            if (caller.sent) {
+                *caller.sent = sent;
+            }
+            caller.waiter->notify();
+        }
+        // clear() keeps the capacity, so steady state does not allocate.
+        mCallers.clear();
+        mInFlight = false;
+    }
+
+    uint64_t sent () const { return mSent; }
+    uint64_t saved () const { return mSaved; }
+
+private:
+    std::mutex mMutex;
+    std::vector<Caller> mCallers;
+    bool mInFlight = false;
+    std::atomic<uint64_t> mSent{0};
+    std::atomic<uint64_t> mSaved{0};
+};
+
+} // namespace baromesh
+
+#endif
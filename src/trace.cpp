@@ -0,0 +1,85 @@
+#include "trace.hpp"
+
+#include <stdexcept>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace baromesh {
+
+Tracer& Tracer::global () {
+    static Tracer tracer;
+    return tracer;
+}
+
+uint32_t Tracer::threadId () {
+    static std::atomic<uint32_t> next{1};
+    static thread_local uint32_t id = next++;
+    return id;
+}
+
+void Tracer::start (size_t capacity) {
+    std::lock_guard<std::mutex> lock{mMutex};
+    mSpans.clear();
+    mSpans.reserve(capacity);
+    mCapacity = capacity;
+    mDropped = 0;
+    mEnabled = true;
+}
+
+void Tracer::span (const char* name, const char* category, int64_t begin, int64_t end,
+                   const char* argName, int64_t arg) {
+    if (!enabled()) {
+        return;
+    }
+    auto thread = threadId();
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (mSpans.size() < mCapacity) {
+        mSpans.push_back(Span{name, category, begin, end, thread, argName, arg});
+    }
+    else {
+        ++mDropped;
+    }
+}
+
+void Tracer::stop (const std::string& path) {
+    mEnabled = false;
+    auto spans = std::vector<Span>{};
+    auto dropped = uint64_t{};
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        spans.swap(mSpans);
+        dropped = mDropped;
+    }
+
+    auto f = fopen(path.c_str(), "w");
+    if (!f) {
+        throw std::runtime_error(path + ": " + strerror(errno));
+    }
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%" PRIu64 "},"
+               "\"traceEvents\":[\n", dropped);
+    auto first = true;
+    for (auto& s : spans) {
+        fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%" PRId64,
+            first ? "" : ",\n", s.name, s.category, s.thread, s.begin);
+        if (s.end == s.begin) {
+            fprintf(f, ",\"ph\":\"i\",\"s\":\"t\"");
+        }
+        else {
+            fprintf(f, ",\"ph\":\"X\",\"dur\":%" PRId64, s.end - s.begin);
+        }
+        if (s.argName) {
+            fprintf(f, ",\"args\":{\"%s\":%" PRId64 "}", s.argName, s.arg);
+        }
+        fprintf(f, "}");
+        first = false;
+    }
+    fprintf(f, "\n]}\n");
+    if (fclose(f)) {
+        throw std::runtime_error(path + ": " + strerror(errno));
+    }
+}
+
+} // namespace baromesh
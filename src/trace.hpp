@@ -0,0 +1,90 @@
+#ifndef BAROMESH_TRACE_HPP
+#define BAROMESH_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace baromesh {
+
+// Process-wide, opt-in recorder of timed spans, written out in the Chrome
+// trace-event format (chrome://tracing, Perfetto). While tracing is off,
+// instrumented code pays one relaxed atomic load per span.
+class Tracer {
+public:
+    static Tracer& global ();
+
+    // Host steady-clock time in microseconds, the trace's time base.
+    static int64_t now () {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Small, stable number for the calling thread.
+    static uint32_t threadId ();
+
+    bool enabled () const { return mEnabled.load(std::memory_order_relaxed); }
+
+    // Discard anything recorded and start recording up to capacity spans.
+    void start (size_t capacity);
+
+    // Stop recording and write what was recorded to path. Throws
+    // std::runtime_error if the file cannot be written.
+    void stop (const std::string& path);
+
+    // Record a span on the calling thread. name and category must be string
+    // literals or otherwise outlive the trace. A span with begin == end is an
+    // instant. argName, if given, labels one integer argument.
+    void span (const char* name, const char* category, int64_t begin, int64_t end,
+               const char* argName = nullptr, int64_t arg = 0);
+
+private:
+    struct Span {
+        const char* name;
+        const char* category;
+        int64_t begin;
+        int64_t end;
+        uint32_t thread;
+        const char* argName;
+        int64_t arg;
+    };
+
+    std::atomic<bool> mEnabled{false};
+    std::mutex mMutex;
+    std::vector<Span> mSpans;
+    size_t mCapacity = 0;
+    uint64_t mDropped = 0;
+};
+
+// Records a span from construction to destruction, if tracing was on at
+// construction.
+class TraceScope {
+public:
+    TraceScope (const char* name, const char* category)
+        : mName(name)
+        , mCategory(category)
+        , mBegin(Tracer::global().enabled() ? Tracer::now() : 0)
+    {}
+
+    ~TraceScope () {
+        if (mBegin) {
+            Tracer::global().span(mName, mCategory, mBegin, Tracer::now());
+        }
+    }
+
+    TraceScope (const TraceScope&) = delete;
+    TraceScope& operator= (const TraceScope&) = delete;
+
+private:
+    const char* mName;
+    const char* mCategory;
+    int64_t mBegin;
+};
+
+} // namespace baromesh
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef BAROMESH_WAITER_HPP
+#define BAROMESH_WAITER_HPP
+
+#include <atomic>
+#include <chrono>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace baromesh {
+
+// Blocks a thread until some number of asynchronous completions have been
+// delivered, without the shared state allocation and mutex/condition variable
+// handshake of std::promise/std::future. Each thread has one reusable Waiter;
+// arm() it, hand a reference to the completion handlers, and wait().
+//
+// On Linux the waiting thread parks on a futex, so a completion which arrives
+// while the waiter is still spinning costs no system call at all.
+class Waiter {
+public:
+    static Waiter& local () {
+        static thread_local Waiter waiter;
+        return waiter;
+    }
+
+    // Expect n calls to notify() before wait() returns.
+    void arm (int n = 1) {
+        mPending.store(n);
+    }
+
+    // Deliver one completion. May be called from any thread.
+    void notify () {
+        if (1 == mPending.fetch_sub(1)) {
+#ifdef __linux__
+            if (mParked.exchange(0)) {
+                syscall(SYS_futex, &mParked, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+            }
+#else
+            std::lock_guard<std::mutex> lock{mMutex};
+            mCondition.notify_all();
+#endif
+        }
+    }
+
+    // Spin for up to spinBudget, then sleep until every expected completion
+    // has been delivered.
+    void wait (std::chrono::nanoseconds spinBudget = std::chrono::nanoseconds::zero()) {
+        if (spinBudget != std::chrono::nanoseconds::zero()) {
+            auto deadline = std::chrono::steady_clock::now() + spinBudget;
+            while (mPending.load(std::memory_order_acquire)
+                   && std::chrono::steady_clock::now() < deadline) {
+            }
+        }
+#ifdef __linux__
+        while (mPending.load()) {
+            mParked.store(1);
+            if (!mPending.load()) {
+                mParked.store(0);
+                break;
+            }
+            syscall(SYS_futex, &mParked, FUTEX_WAIT_PRIVATE, 1, nullptr, nullptr, 0);
+        }
+#else
+        std::unique_lock<std::mutex> lock{mMutex};
+        mCondition.wait(lock, [this] { return !mPending.load(); });
+#endif
+    }
+
+private:
+    Waiter () = default;
+
+    std::atomic<int> mPending{0};
+#ifdef __linux__
+    std::atomic<int> mParked{0};
+#else
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+#endif
+};
+
+} // namespace baromesh
+
+#endif
@@ -3,13 +3,17 @@
 
 #include <rpc/asio/client.hpp>
 
+#include "messagequeue.hpp"
+
 #include <baromesh/websocketconnector.hpp>
 
 #include <utility>
 
 namespace baromesh {
 
-using WebSocketClient = rpc::asio::Client<websocket::Connector::MessageQueue>;
+// The name predates other transports: the client's MessageQueue may be
+// backed by a WebSocket or by a local socket, chosen when connecting.
+using WebSocketClient = rpc::asio::Client<MessageQueue>;
 
 } // namespace baromesh
 
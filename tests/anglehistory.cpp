@@ -0,0 +1,77 @@
+// Check the joint angle ring buffer's interpolation and velocity estimates.
+#include "anglehistory.hpp"
+#include "check.hpp"
+
+#include <cmath>
+
+using baromesh::AngleHistory;
+
+bool near (double a, double b) {
+    return std::abs(a - b) < 1e-6;
+}
+
+int main () {
+    double d;
+
+    AngleHistory h{4};
+    check(!h.angleAt(0, d), "empty history answers nothing");
+    check(!h.velocity(100, d), "empty history has no velocity");
+
+    // 10 degrees every 100 ms: 100 deg/s.
+    h.push(1000, 0);
+    h.push(1100, 10);
+    h.push(1200, 20);
+    check(h.angleAt(1100, d) && near(d, 10), "exact sample");
+    check(h.angleAt(1150, d) && near(d, 15), "interpolates between samples");
+    check(h.angleAt(1000, d) && near(d, 0), "oldest sample");
+    check(h.angleAt(1200, d) && near(d, 20), "newest sample");
+    check(!h.angleAt(999, d), "no extrapolation into the past");
+    check(!h.angleAt(1201, d), "no extrapolation into the future");
+    check(h.velocity(1000, d) && near(d, 100), "velocity over the whole history");
+    check(h.velocity(0, d) && near(d, 100), "velocity uses at least two samples");
+
+    // Overwrite the oldest once full.
+    h.push(1300, 30);
+    h.push(1400, 40);
+    check(4 == h.size(), "capacity bounds the size");
+    check(!h.angleAt(1000, d), "oldest sample overwritten");
+    check(h.angleAt(1350, d) && near(d, 35), "interpolates across the wrap");
+
+    // A repeated timestamp replaces the newest sample.
+    h.push(1400, 41);
+    check(4 == h.size() && near(h.newest().degrees, 41), "same timestamp replaces");
+
+    // The window limits the fit: the joint sped up to 200 deg/s.
+    h.push(1450, 51);
+    h.push(1500, 61);
+    check(h.velocity(100, d) && near(d, 200), "window selects recent samples");
+
+    // A late sample takes its place in time instead of clearing the history.
+    AngleHistory late{8};
+    late.push(1000, 0);
+    late.push(1200, 20);
+    late.push(1100, 12);
+    check(3 == late.size(), "late sample inserted");
+    check(late.angleAt(1050, d) && near(d, 6), "interpolates before a late sample");
+    check(late.angleAt(1150, d) && near(d, 16), "interpolates after a late sample");
+    check(near(late.newest().degrees, 20), "late sample is not the newest");
+    late.push(1100, 10);
+    check(3 == late.size() && late.angleAt(1100, d) && near(d, 10),
+          "duplicate of a late sample replaces it");
+
+    // A late sample older than a full history's oldest is dropped.
+    h.push(1250, 999);
+    check(4 == h.size() && !h.angleAt(1250, d) && h.angleAt(1300, d) && near(d, 30),
+          "stale sample dropped");
+    h.push(1475, 56);
+    check(4 == h.size() && !h.angleAt(1350, d), "late sample into a full history drops the oldest");
+    check(h.angleAt(1475, d) && near(d, 56) && h.angleAt(1490, d) && near(d, 59),
+          "late sample into a full history");
+
+    // A timestamp going far backward means the robot restarted.
+    h.push(10, 5);
+    check(1 == h.size(), "clock reset clears history");
+    check(!h.velocity(100, d), "one sample has no velocity");
+
+    return report("anglehistory");
+}
@@ -0,0 +1,95 @@
+# Tracks how long the library takes to build and how big it is.
+#
+#   cmake -DBUILD_DIR=<build tree> [-DCONFIG=<config>] -P tests/buildstats.cmake
+#
+# Touches each of the library's sources in turn and times the rebuild, i.e.,
+# the cost of an incremental build after editing that file, then removes the
+# objects and times a build of the whole library. Reports the size of each
+# object and of the library, and appends them to buildstats.csv in the build
+# tree so that runs can be compared from change to change. Times are to the
+# second. Run it outside of any other build of the same tree.
+cmake_minimum_required(VERSION 3.14)
+
+if(NOT BUILD_DIR)
+    message(FATAL_ERROR
+        "usage: cmake -DBUILD_DIR=<build tree> [-DCONFIG=<config>] -P buildstats.cmake")
+endif()
+get_filename_component(SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+get_filename_component(BUILD_DIR "${BUILD_DIR}" ABSOLUTE)
+
+set(build_args --build "${BUILD_DIR}" --target baromesh)
+if(CONFIG)
+    list(APPEND build_args --config ${CONFIG})
+endif()
+
+function(timed_build seconds)
+    string(TIMESTAMP begin "%s" UTC)
+    execute_process(COMMAND "${CMAKE_COMMAND}" ${build_args}
+        RESULT_VARIABLE result
+        OUTPUT_QUIET)
+    string(TIMESTAMP end "%s" UTC)
+    if(result)
+        message(FATAL_ERROR "building baromesh failed: ${result}")
+    endif()
+    math(EXPR elapsed "${end} - ${begin}")
+    set(${seconds} ${elapsed} PARENT_SCOPE)
+endfunction()
+
+# Start from an up-to-date tree, so each timing below covers one change.
+timed_build(ignored)
+
+file(GLOB_RECURSE objects
+    "${BUILD_DIR}/*/baromesh.dir/*.o"
+    "${BUILD_DIR}/*/baromesh.dir/*.obj")
+if(NOT objects)
+    message(FATAL_ERROR "no baromesh objects under ${BUILD_DIR}")
+endif()
+list(SORT objects)
+
+file(GLOB_RECURSE libraries
+    "${BUILD_DIR}/libbaromesh.a"
+    "${BUILD_DIR}/libbaromesh.so.*"
+    "${BUILD_DIR}/libbaromesh.*.dylib"
+    "${BUILD_DIR}/baromesh.lib"
+    "${BUILD_DIR}/baromesh.dll")
+set(library)
+foreach(candidate ${libraries})
+    if(NOT IS_SYMLINK "${candidate}")
+        set(library "${candidate}")
+    endif()
+endforeach()
+
+string(TIMESTAMP now "%Y-%m-%dT%H:%M:%SZ" UTC)
+set(csv "${BUILD_DIR}/buildstats.csv")
+if(NOT EXISTS "${csv}")
+    file(WRITE "${csv}" "time,item,seconds,bytes\n")
+endif()
+
+# Objects are named after their source: src/linkbot.cpp.o, or linkbot.obj.
+message(STATUS "incremental build after touching each source:")
+foreach(object ${objects})
+    get_filename_component(name "${object}" NAME)
+    string(REGEX REPLACE "\\.(o|obj)$" "" name "${name}")
+    string(REGEX REPLACE "\\.cpp$" "" name "${name}")
+    set(source "src/${name}.cpp")
+    if(NOT EXISTS "${SOURCE_DIR}/${source}")
+        continue()
+    endif()
+    file(TOUCH "${SOURCE_DIR}/${source}")
+    timed_build(seconds)
+    file(SIZE "${object}" bytes)
+    math(EXPR kilobytes "${bytes} / 1024")
+    message(STATUS "  ${source}: ${seconds} s, ${kilobytes} KB")
+    file(APPEND "${csv}" "${now},${source},${seconds},${bytes}\n")
+endforeach()
+
+file(REMOVE ${objects})
+timed_build(seconds)
+set(bytes 0)
+if(library)
+    file(SIZE "${library}" bytes)
+endif()
+math(EXPR kilobytes "${bytes} / 1024")
+message(STATUS "full build: ${seconds} s, library ${kilobytes} KB")
+file(APPEND "${csv}" "${now},baromesh,${seconds},${bytes}\n")
+message(STATUS "appended to ${csv}")
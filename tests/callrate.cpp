@@ -0,0 +1,86 @@
+// Blocking calls per second. First the bare cost of handing a completion from
+// an I/O thread back to a blocked caller, using std::promise/std::future (the
+// old synchronous path) and baromesh::Waiter (the current one). Then a
+// setLedColor loop like speeddial through the whole RPC path, against a
+// simulated robot in this process or, given a host and service, a real one.
+#include "baromesh/linkbot.hpp"
+#include "baromesh/simulator.hpp"
+#include "waiter.hpp"
+
+#include <boost/asio/io_service.hpp>
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+const auto kDuration = std::chrono::seconds{3};
+
+template <class Call>
+double callsPerSecond (Call&& call) {
+    auto n = 0ull;
+    auto start = Clock::now();
+    auto end = start + kDuration;
+    while (Clock::now() < end) {
+        call();
+        ++n;
+    }
+    return n / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void handoff () {
+    boost::asio::io_service context;
+    boost::asio::io_service::work work { context };
+    std::thread ioThread { [&context] { context.run(); } };
+
+    auto future = callsPerSecond([&context] {
+        auto done = std::promise<int>{};
+        auto doneFuture = done.get_future();
+        context.post([&done] { done.set_value(0); });
+        doneFuture.get();
+    });
+    printf("%-28s %12.0f calls/s\n", "handoff std::future", future);
+
+    auto waiter = callsPerSecond([&context] {
+        auto& w = baromesh::Waiter::local();
+        w.arm();
+        context.post([&w] { w.notify(); });
+        w.wait();
+    });
+    printf("%-28s %12.0f calls/s (%.2fx)\n", "handoff baromesh::Waiter", waiter, waiter / future);
+
+    context.stop();
+    ioThread.join();
+}
+
+int main (int argc, char** argv) {
+    handoff();
+
+    try {
+        std::unique_ptr<barobo::Simulator> sim;
+        std::unique_ptr<barobo::Linkbot> linkbot;
+        if (argc >= 3) {
+            linkbot.reset(new barobo::Linkbot{argv[1], argv[2]});
+        }
+        else {
+            sim.reset(new barobo::Simulator{"inproc://callrate"});
+            linkbot.reset(new barobo::Linkbot{sim->endpoint()});
+        }
+        int i = 0;
+        auto rate = callsPerSecond([&linkbot, &i] {
+            linkbot->setLedColor(i & 0xff, 0, 0xff - (i & 0xff));
+            ++i;
+        });
+        printf("%-28s %12.0f calls/s (%s)\n", "setLedColor", rate,
+            sim ? "simulator" : "robot");
+    }
+    catch (std::exception& e) {
+        std::cout << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
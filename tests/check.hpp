@@ -0,0 +1,29 @@
+#ifndef BAROMESH_TESTS_CHECK_HPP
+#define BAROMESH_TESTS_CHECK_HPP
+
+// The tests' shared check: each failed check is printed and counted, and
+// main returns report(name) at the end.
+
+#include <iostream>
+
+#include <cstdio>
+
+static int failures = 0;
+
+static void check (bool ok, const char* what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << '\n';
+        ++failures;
+    }
+}
+
+// Exit status for main: 1 if any check failed, otherwise 0, after saying so.
+static int report (const char* name) {
+    if (failures) {
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,55 @@
+// Check that the clock-sync estimator recovers a known offset and drift from
+// noisy round trips.
+#include "clocksync.hpp"
+#include "check.hpp"
+
+#include <random>
+
+#include <cmath>
+
+using baromesh::ClockSync;
+
+int main () {
+    ClockSync c;
+    check(!c.valid(), "no estimate without samples");
+
+    // The robot's clock started 5 s after the host's and runs 50 ppm fast.
+    // Requests take 200-2000 us each way, asymmetrically.
+    const double offset = 5e6;
+    const double ppm = 50;
+    auto robotAt = [&] (double host) {
+        return int(std::floor((host - offset) / 1000.0 * (1 + ppm * 1e-6)));
+    };
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<double> leg{200, 2000};
+    auto host = 10e6;
+    for (int i = 0; i < 64; ++i) {
+        auto send = host;
+        auto served = send + leg(rng);
+        auto receive = served + leg(rng);
+        c.add(int64_t(send), int64_t(receive), robotAt(served));
+        host += 1e6;
+    }
+    check(c.valid(), "estimate after samples");
+
+    // The robot clock's millisecond resolution alone is worth 1000 us.
+    auto error = std::abs(double(c.toHost(robotAt(host))) - host);
+    check(error < 2500, "maps robot time to host time");
+    check(std::abs(c.driftPpm() - ppm) < 25, "estimates drift");
+    check(std::abs(c.toRobot(c.toHost(123456)) - 123456) <= 1, "toRobot inverts toHost");
+    check(c.uncertainty() >= 200 && c.uncertainty() <= 2000, "uncertainty from quickest round trip");
+
+    // A reordered reply, older than the newest sample, leaves the estimate be.
+    auto before = c.toHost(robotAt(host));
+    c.add(int64_t(host), int64_t(host) + 1000, robotAt(host - 3e6));
+    check(c.toHost(robotAt(host)) == before, "stale sample ignored");
+
+    // After a reconnect, the estimate starts over.
+    c.clear();
+    check(!c.valid(), "clear forgets the estimate");
+    c.add(int64_t(host), int64_t(host) + 1000, 10);
+    check(std::abs(double(c.toHost(10)) - (host + 500)) < 1, "clock reset clears samples");
+    check(0 == c.driftPpm(), "no drift from one sample");
+
+    return report("clocksync");
+}
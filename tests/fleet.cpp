@@ -0,0 +1,61 @@
+// Check that a fleet table's rows follow their robots and that its queries
+// pick out the right rows, using simulated robots in this process.
+#include "baromesh/fleet.hpp"
+#include "baromesh/linkbot.hpp"
+#include "baromesh/simulator.hpp"
+#include "check.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <cmath>
+
+using Rows = std::vector<size_t>;
+
+int main () {
+    barobo::Simulator sim0 { "inproc://fleet-0" };
+    barobo::Simulator sim1 { "inproc://fleet-1" };
+    barobo::Linkbot robot0 { sim0.endpoint() };
+    barobo::Linkbot robot1 { sim1.endpoint() };
+
+    barobo::FleetTable table;
+    check(0 == table.add(robot0) && 1 == table.add(robot1), "rows in order of addition");
+    check(2 == table.size(), "size counts rows");
+    check(table.batteryBelow(5).empty(), "unreported battery matches nothing");
+
+    // Getter replies fill the rows.
+    int timestamp;
+    double a0, a1, a2, x, y, z, volts;
+    for (auto robot : { &robot0, &robot1 }) {
+        robot->getBatteryVoltage(volts);
+        robot->getAccelerometer(timestamp, x, y, z);
+    }
+    check(Rows({0, 1}) == table.batteryBelow(5), "battery below");
+    check(table.batteryBelow(3).empty(), "battery above");
+    check(table.tiltExceeds(10).empty(), "level robots are not tilted");
+
+    // Move one robot's first joint past 90 degrees and wait for it to arrive.
+    robot1.moveTo(0x01, 100, 0, 0);
+    auto held = false;
+    for (int i = 0; i < 50 && !held; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        held = table.jointInState(barobo::JointState::HOLD) == Rows({1});
+    }
+    check(held, "joint event updates the state column");
+    robot1.getJointAngles(timestamp, a0, a1, a2);
+    check(Rows({1}) == table.jointBeyond(90), "joint beyond");
+    check(table.jointBeyond(110).empty(), "joint within");
+
+    double angles[3], accel[3];
+    barobo::JointState::Type states[3];
+    table.get(1, angles, accel, states, volts);
+    check(std::abs(angles[0] - a0) < 0.01 && barobo::JointState::HOLD == states[0]
+          && 1 == accel[2] && volts > 0, "get copies out a row");
+
+    // A removed row is no longer reported.
+    table.remove(0);
+    check(Rows({1}) == table.batteryBelow(5), "removed row not reported");
+
+    return report("fleet");
+}
@@ -0,0 +1,95 @@
+// Check the AIMD flow-control window's queueing, growth and backoff.
+#include "flowwindow.hpp"
+#include "check.hpp"
+
+using baromesh::FlowWindow;
+
+// Counts its starts and aborts.
+struct Counted : FlowWindow::Request {
+    Counted (int& s, int* a = nullptr) : started(s), aborted(a) {}
+    void start () override { ++started; }
+    bool cancellable () const override { return aborted; }
+    void abort () override { ++*aborted; }
+    int& started;
+    int* aborted;
+};
+
+int main () {
+    FlowWindow w{16};
+    auto started = 0;
+
+    // The initial window admits four; the rest queue.
+    for (int i = 0; i < 6; ++i) {
+        w.submit(new Counted{started});
+    }
+    check(4 == started, "initial window");
+    check(!w.tryAcquire(), "full window refuses inline starts");
+    check(4 == w.stats().inFlight && 2 == w.stats().queued, "excess queued");
+
+    // Completions at a steady round trip start queued requests and grow the
+    // window by about one per window's worth.
+    for (int i = 0; i < 4; ++i) {
+        w.complete(10000, false);
+    }
+    check(6 == started, "queue drained by completions");
+    check(w.stats().window > 4.9 && w.stats().window < 5.1, "additive increase");
+
+    // Keep the pipe full for a while: the window grows to its maximum.
+    for (int i = 0; i < 400; ++i) {
+        w.submit(new Counted{started});
+        w.complete(10000, false);
+    }
+    check(16 == w.stats().window, "capped at the maximum");
+
+    // A timeout halves it, but a burst of them only counts once.
+    w.complete(0, true);
+    auto after = w.stats();
+    check(8 == after.window && 1 == after.decreases, "multiplicative decrease");
+    for (int i = 0; i < 3; ++i) {
+        w.submit(new Counted{started});
+        w.complete(0, true);
+    }
+    check(1 == w.stats().decreases, "one decrease per window");
+
+    // A round trip far above the baseline counts as congestion.
+    for (int i = 0; i < 16; ++i) {
+        w.submit(new Counted{started});
+        w.complete(10000, false);
+    }
+    auto before = w.stats().decreases;
+    w.submit(new Counted{started});
+    w.complete(50000, false);
+    check(before + 1 == w.stats().decreases, "RTT inflation backs off");
+
+    // Failures other than timeouts say nothing about congestion.
+    auto window = w.stats().window;
+    w.submit(new Counted{started});
+    w.complete(0, false);
+    check(window == w.stats().window, "errors leave the window alone");
+
+    // Lowering the limit shrinks the window.
+    w.setMaxWindow(2);
+    check(2 >= w.stats().window, "limit applies");
+
+    // Urgent requests skip the queue and the window, and can cancel the
+    // queued requests they supersede.
+    FlowWindow u{1};
+    started = 0;
+    auto aborted = 0;
+    u.submit(new Counted{started});
+    u.submit(new Counted{started, &aborted});
+    u.submit(new Counted{started});
+    check(1 == started && 2 == u.stats().queued, "window of one");
+    check(!u.tryAcquire(), "no inline start while others wait");
+    u.acquireUrgent();
+    check(2 == u.stats().inFlight, "urgent bypasses the window");
+    u.cancelQueued();
+    check(1 == aborted && 1 == u.stats().queued, "cancellable requests aborted");
+    u.complete(10000, false);
+    u.complete(10000, false);
+    check(2 == started && 0 == u.stats().queued, "uncancellable request still runs");
+    u.complete(10000, false);
+    check(u.tryAcquire() && 1 == u.stats().inFlight, "inline start when the window has room");
+
+    return report("flowwindow");
+}
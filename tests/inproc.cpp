@@ -0,0 +1,72 @@
+// Exercise the in-process transport: connect, accept, messages in both
+// directions, queued and waiting receives, and end-of-stream on close.
+#include "inproc.hpp"
+#include "check.hpp"
+
+#include <boost/asio/io_service.hpp>
+
+#include <string>
+
+#include <cstring>
+
+namespace inproc = baromesh::inproc;
+
+int main () {
+    boost::asio::io_service ios;
+    inproc::Listener listener { ios, "test" };
+    inproc::MessageQueue client { ios };
+    inproc::MessageQueue server { ios };
+
+    auto ec = boost::system::error_code{};
+    auto n = size_t(0);
+    char buf[32];
+
+    auto onSend = [&ec] (boost::system::error_code e) { ec = e; };
+    auto onReceive = [&ec, &n] (boost::system::error_code e, size_t size) { ec = e; n = size; };
+    auto run = [&ios] { ios.run(); ios.reset(); };
+
+    // Connection arrives before the accept.
+    inproc::connect(client, "test");
+    ec = boost::asio::error::would_block;
+    listener.asyncAccept(server, onSend);
+    run();
+    check(!ec, "accept");
+
+    // Receive already waiting.
+    server.asyncReceive(boost::asio::buffer(buf), onReceive);
+    client.asyncSend(boost::asio::buffer("ping", 4), onSend);
+    run();
+    check(!ec && n == 4 && !memcmp(buf, "ping", 4), "waiting receive");
+
+    // Message queued in the inbox first.
+    server.asyncSend(boost::asio::buffer("pong!", 5), onSend);
+    run();
+    client.asyncReceive(boost::asio::buffer(buf), onReceive);
+    run();
+    check(!ec && n == 5 && !memcmp(buf, "pong!", 5), "queued receive");
+
+    // Too small a buffer.
+    client.asyncSend(boost::asio::buffer("0123456789", 10), onSend);
+    server.asyncReceive(boost::asio::buffer(buf, 4), onReceive);
+    run();
+    check(ec == boost::asio::error::message_size, "message_size");
+
+    // Close reaches the peer as end-of-stream.
+    server.asyncReceive(boost::asio::buffer(buf), onReceive);
+    client.close();
+    run();
+    check(ec == boost::asio::error::eof, "eof");
+
+    // Nothing listening.
+    inproc::MessageQueue stray { ios };
+    auto threw = false;
+    try {
+        inproc::connect(stray, "nobody");
+    }
+    catch (std::exception&) {
+        threw = true;
+    }
+    check(threw, "connect to unbound name");
+
+    return report("inproc");
+}
@@ -0,0 +1,70 @@
+// Check the simulator's joint kinematics against hand-computed motions.
+#include "jointmodel.hpp"
+#include "check.hpp"
+
+#include <cmath>
+
+using baromesh::JointModel;
+namespace JointState = barobo::JointState;
+
+bool near (double a, double b) {
+    return std::abs(a - b) < 1e-6;
+}
+
+// Step j in 10 ms increments for seconds; return the number of state changes.
+int run (JointModel& j, double seconds) {
+    auto changes = 0;
+    for (auto t = 0.0; t < seconds - 1e-9; t += 0.01) {
+        changes += j.step(0.01);
+    }
+    return changes;
+}
+
+int main () {
+    auto deg = JointModel::radians;
+
+    // A 90 degree move at 90 deg/s takes one second and ends holding.
+    JointModel j;
+    j.moveTo(deg(90));
+    run(j, 0.5);
+    check(near(j.angle, deg(45)), "halfway after 0.5 s");
+    check(JointState::MOVING == j.state, "moving mid-move");
+    check(1 == run(j, 0.6), "one state change at the end");
+    check(near(j.angle, deg(90)) && JointState::HOLD == j.state, "arrives and holds");
+
+    // Smooth moves arrive too, just later.
+    JointModel s;
+    s.moveTo(deg(90), true);
+    run(s, 1.0);
+    check(JointState::MOVING == s.state && s.angle < deg(90), "smooth move still ramping");
+    run(s, 1.0);
+    check(near(s.angle, deg(90)) && JointState::HOLD == s.state, "smooth move arrives");
+
+    // Continuous motion until stopped, then coast.
+    JointModel c;
+    c.moveAt(deg(-30));
+    run(c, 2.0);
+    check(near(c.angle, deg(-60)), "continuous motion");
+    c.stop();
+    check(!c.step(0.01) && JointState::COAST == c.state, "stopped joint stays put");
+
+    // Zero velocity, e.g. motorPower(0), is not motion: the joint coasts, or
+    // holds if asked, instead of reporting MOVING forever.
+    JointModel z;
+    z.moveAt(deg(30));
+    run(z, 0.5);
+    z.moveAt(0);
+    check(JointState::COAST == z.state && near(z.velocity, 0), "zero velocity coasts");
+    check(0 == run(z, 1.0) && near(z.angle, deg(15)), "coasting joint stays put");
+    z.moveAt(0, JointState::HOLD);
+    check(JointState::HOLD == z.state, "zero velocity can hold");
+
+    // Acceleration saturates at the top speed; timeout ends the motion.
+    JointModel a;
+    a.accelerate(deg(1000));
+    a.setTimeout(1.0, JointState::HOLD);
+    check(1 == run(a, 1.5), "timeout changes state once");
+    check(JointState::HOLD == a.state && near(a.velocity, 0), "timeout end state");
+
+    return report("jointmodel");
+}
@@ -0,0 +1,90 @@
+// Round-trip latency of a blocking getter in one I/O mode, "blocking" or
+// "busy-poll". Prints percentiles so the tail can be compared between modes.
+// Run each mode in its own process, so neither inherits the other's threads,
+// caches or allocator state. Without a host and service, measures against a
+// simulated robot in this process.
+#include "baromesh/linkbot.hpp"
+#include "baromesh/simulator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<double> measure (barobo::Linkbot& linkbot, int iterations) {
+    int timestamp;
+    double a0, a1, a2;
+    auto ec = boost::system::error_code{};
+
+    // Warm up caches, the link, and the I/O thread, and discard the results.
+    for (int i = 0; i < 100; ++i) {
+        linkbot.getJointAngles(timestamp, a0, a1, a2, ec);
+    }
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        linkbot.getJointAngles(timestamp, a0, a1, a2, ec);
+        auto end = Clock::now();
+        if (ec) {
+            std::cout << "getJointAngles: " << ec.message() << '\n';
+            continue;
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples;
+}
+
+void report (const char* mode, const std::vector<double>& samples) {
+    auto pct = [&samples] (double p) {
+        return samples[std::min(samples.size() - 1, size_t(p * samples.size()))];
+    };
+    printf("%-10s n=%-7zu p50=%8.1fus p90=%8.1fus p99=%8.1fus p99.9=%8.1fus max=%8.1fus\n",
+        mode, samples.size(), pct(0.5), pct(0.9), pct(0.99), pct(0.999), samples.back());
+}
+
+int main (int argc, char** argv) {
+    auto busyPoll = argc > 1 && !strcmp(argv[1], "busy-poll");
+    if (argc < 2 || (!busyPoll && strcmp(argv[1], "blocking")) || 3 == argc) {
+        printf("Usage: %s blocking|busy-poll [<host> <service> [iterations]]\n"
+               "e.g., %s busy-poll 127.0.0.1 42010 10000\n",
+            argv[0], argv[0]);
+        return 1;
+    }
+    auto iterations = argc > 4 ? atoi(argv[4]) : 10000;
+
+    try {
+        barobo::Linkbot::setIoThreadPool(1, busyPoll, busyPoll);
+
+        std::unique_ptr<barobo::Simulator> sim;
+        std::unique_ptr<barobo::Linkbot> linkbot;
+        if (argc > 3) {
+            linkbot.reset(new barobo::Linkbot{argv[2], argv[3]});
+        }
+        else {
+            sim.reset(new barobo::Simulator{"inproc://latency"});
+            linkbot.reset(new barobo::Linkbot{sim->endpoint()});
+        }
+
+        auto samples = measure(*linkbot, iterations);
+        if (samples.empty()) {
+            std::cout << argv[1] << ": no samples\n";
+            return 1;
+        }
+        report(argv[1], samples);
+    }
+    catch (std::exception& e) {
+        std::cout << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,46 @@
+// Check the latest-value-wins slot: coalescing, withdrawal, and which
+// failures are reported to later posts.
+#include "latestwins.hpp"
+#include "check.hpp"
+
+using baromesh::JointValues;
+using baromesh::LatestWins;
+
+int main () {
+    auto ec = boost::system::error_code{};
+    auto timedOut = make_error_code(boost::system::errc::timed_out);
+    JointValues next;
+
+    LatestWins<JointValues> slot;
+    check(slot.post(JointValues{0x01, {10, 0, 0}}, ec) && !ec, "first value sent now");
+    check(!slot.post(JointValues{0x02, {0, 20, 0}}, ec), "second value pending");
+    check(!slot.post(JointValues{0x01, {30, 0, 0}}, ec), "third value coalesced");
+    check(1 == slot.superseded(), "coalescing counted");
+    check(slot.complete({}, next) && 0x03 == next.mask && 30 == next.values[0]
+          && 20 == next.values[1], "pending value keeps the newest per joint");
+    check(!slot.complete({}, next) && slot.idle(), "idle once nothing is pending");
+
+    // A failure is reported once, by the next post.
+    slot.post(JointValues{0x01, {10, 0, 0}}, ec);
+    slot.complete(timedOut, next);
+    check(slot.post(JointValues{0x01, {10, 0, 0}}, ec) && timedOut == ec,
+          "failure reported to the next post");
+    slot.complete({}, next);
+    slot.post(JointValues{0x01, {10, 0, 0}}, ec);
+    check(!ec, "failure reported only once");
+
+    // A stop withdraws its joints from the pending value and abandons the
+    // request in flight without reporting a failure.
+    slot.post(JointValues{0x03, {10, 20, 0}}, ec);
+    slot.withdraw(0x01);
+    check(slot.abandon(next) && 0x02 == next.mask && 20 == next.values[1],
+          "withdrawn joints dropped from the pending value");
+    check(!slot.abandon(next) && slot.idle(), "abandoned request leaves the slot idle");
+    check(slot.post(JointValues{0x01, {0, 0, 0}}, ec) && !ec,
+          "abandoned request not reported to the next post");
+    slot.post(JointValues{0x01, {10, 0, 0}}, ec);
+    slot.withdraw(0x01);
+    check(!slot.complete({}, next), "fully withdrawn value not sent");
+
+    return report("latestwins");
+}
@@ -0,0 +1,239 @@
+// Fleet-scale load generator. For each fleet size N, starts N simulated robots
+// in this process, connects a Linkbot to each, subscribes to encoder and
+// joint events while the joints turn, and drives a mix of getJointAngles,
+// setLedColor and move from a pool of worker threads. Prints one line per N:
+// request throughput and latency percentiles, event throughput, CPU used by
+// the I/O threads, and resident memory per robot.
+//
+// The simulators share the I/O threads with the Linkbots, so the I/O CPU
+// figure covers both ends of every connection.
+#include "baromesh/linkbot.hpp"
+#include "baromesh/simulator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    double seconds = 5;
+    unsigned ioThreads = 1;
+    unsigned workers = 0;      // 0: one per hardware thread
+    double granularity = 5;    // encoder event granularity, degrees
+    int getPercent = 70;       // the rest split between setLedColor and move
+    int setPercent = 20;
+    std::vector<int> fleetSizes;
+};
+
+std::atomic<uint64_t> gEvents{0};
+
+void onEncoder (int, double, int, void*) { ++gEvents; }
+void onJoint (int, barobo::JointState::Type, int, void*) { ++gEvents; }
+
+// CPU seconds used by the whole process, and by the calling thread.
+double processCpu () {
+#ifdef __linux__
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return u.ru_utime.tv_sec + u.ru_stime.tv_sec
+         + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1e6;
+#else
+    return 0;
+#endif
+}
+
+double threadCpu () {
+#ifdef __linux__
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    return 0;
+#endif
+}
+
+// Resident set size in bytes.
+double residentBytes () {
+#ifdef __linux__
+    long pages = 0, resident = 0;
+    if (auto f = fopen("/proc/self/statm", "r")) {
+        if (2 != fscanf(f, "%ld %ld", &pages, &resident)) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return double(resident) * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+struct WorkerResult {
+    std::vector<double> latencies;  // microseconds
+    uint64_t errors = 0;
+    double cpu = 0;
+};
+
+void work (std::vector<barobo::Linkbot*> robots, const Options& opts,
+           Clock::time_point end, unsigned seed, WorkerResult& result) {
+    std::mt19937 rng { seed };
+    std::uniform_int_distribution<int> percent { 0, 99 };
+    auto cpuStart = threadCpu();
+    auto ec = boost::system::error_code{};
+    int timestamp;
+    double a0, a1, a2;
+    for (size_t i = 0; Clock::now() < end; i = (i + 1) % robots.size()) {
+        auto& l = *robots[i];
+        auto p = percent(rng);
+        auto start = Clock::now();
+        if (p < opts.getPercent) {
+            l.getJointAngles(timestamp, a0, a1, a2, ec);
+        }
+        else if (p < opts.getPercent + opts.setPercent) {
+            l.setLedColor(p, 255 - p, 128, ec);
+        }
+        else {
+            l.move(0x01, 10, 0, 0, ec);
+        }
+        auto us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        if (ec) {
+            ++result.errors;
+        }
+        else {
+            result.latencies.push_back(us);
+        }
+    }
+    result.cpu = threadCpu() - cpuStart;
+}
+
+void run (int n, const Options& opts) {
+    auto rssBefore = residentBytes();
+
+    std::vector<std::unique_ptr<barobo::Simulator>> simulators;
+    std::vector<std::unique_ptr<barobo::Linkbot>> linkbots;
+    char name[64];
+    for (int i = 0; i < n; ++i) {
+        snprintf(name, sizeof(name), "inproc://loadgen-%d", i);
+        char serial[8];
+        snprintf(serial, sizeof(serial), "L%03X", i & 0xfff);
+        simulators.emplace_back(new barobo::Simulator{name, serial});
+        linkbots.emplace_back(new barobo::Linkbot{name});
+        auto& l = *linkbots.back();
+        l.setEncoderEventCallback(onEncoder, opts.granularity, nullptr);
+        l.setJointEventCallback(onJoint, nullptr);
+        l.moveContinuous(0x07, 1, -1, 1);
+    }
+    auto rssPerRobot = (residentBytes() - rssBefore) / n;
+
+    auto workers = opts.workers ? opts.workers : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, unsigned(n));
+    std::vector<std::vector<barobo::Linkbot*>> shares(workers);
+    for (int i = 0; i < n; ++i) {
+        shares[i % workers].push_back(linkbots[i].get());
+    }
+
+    std::vector<WorkerResult> results(workers);
+    auto events0 = gEvents.load();
+    auto cpu0 = processCpu();
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(opts.seconds));
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < workers; ++w) {
+        threads.emplace_back(work, shares[w], std::cref(opts), end, w + 1, std::ref(results[w]));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto wall = std::chrono::duration<double>(Clock::now() - start).count();
+    auto cpu = processCpu() - cpu0;
+    auto events = gEvents.load() - events0;
+
+    std::vector<double> samples;
+    uint64_t errors = 0;
+    auto workerCpu = 0.0;
+    for (auto& r : results) {
+        samples.insert(samples.end(), r.latencies.begin(), r.latencies.end());
+        errors += r.errors;
+        workerCpu += r.cpu;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto pct = [&samples] (double p) {
+        return samples.empty() ? 0.0
+             : samples[std::min(samples.size() - 1, size_t(p * samples.size()))];
+    };
+
+    printf("%6d %10.0f %9.1f %9.1f %9.1f %10.0f %7.0f%% %9.1f %7llu\n",
+        n, samples.size() / wall, pct(0.5), pct(0.99), pct(0.999),
+        events / wall, 100 * (cpu - workerCpu) / wall, rssPerRobot / 1024,
+        (unsigned long long)errors);
+    fflush(stdout);
+
+    for (auto& l : linkbots) {
+        auto ec = boost::system::error_code{};
+        l->stop(0x07, ec);
+    }
+    linkbots.clear();
+    simulators.clear();
+}
+
+int usage (const char* argv0) {
+    printf("Usage: %s [-s seconds] [-t io-threads] [-w workers] [-g granularity]\n"
+           "          [-m get%%,set%%] [N ...]\n"
+           "e.g., %s -t 4 -s 10 1 10 100 1000\n", argv0, argv0);
+    return 1;
+}
+
+int main (int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = std::string{argv[i]};
+        auto value = [&] { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if ("-s" == arg && (v = value())) { opts.seconds = atof(v); }
+        else if ("-t" == arg && (v = value())) { opts.ioThreads = unsigned(atoi(v)); }
+        else if ("-w" == arg && (v = value())) { opts.workers = unsigned(atoi(v)); }
+        else if ("-g" == arg && (v = value())) { opts.granularity = atof(v); }
+        else if ("-m" == arg && (v = value())) {
+            if (2 != sscanf(v, "%d,%d", &opts.getPercent, &opts.setPercent)) {
+                return usage(argv[0]);
+            }
+        }
+        else if (atoi(argv[i]) > 0) { opts.fleetSizes.push_back(atoi(argv[i])); }
+        else { return usage(argv[0]); }
+    }
+    if (opts.fleetSizes.empty()) {
+        opts.fleetSizes = { 1, 10, 100, 1000 };
+    }
+
+    try {
+        barobo::Linkbot::setIoThreadPool(opts.ioThreads);
+        printf("%6s %10s %9s %9s %9s %10s %8s %9s %7s\n",
+            "robots", "req/s", "p50(us)", "p99(us)", "p99.9(us)",
+            "events/s", "io-cpu", "KB/robot", "errors");
+        for (auto n : opts.fleetSizes) {
+            run(n, opts);
+        }
+    }
+    catch (std::exception& e) {
+        std::cout << "Exception: " << e.what() << '\n';
+        return 1;
+    }
+}
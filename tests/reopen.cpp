@@ -0,0 +1,74 @@
+// Reopen a robot after its connection died. The handle still holding the dead
+// connection must keep failing, and a new Linkbot for the same robot must make
+// a fresh connection instead of sharing the dead one. Then open and close the
+// same robot from several threads at once, so that the last handle's release
+// races other threads' lookups of the shared connection.
+#include "baromesh/linkbot.hpp"
+#include "baromesh/simulator.hpp"
+#include "check.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main () {
+    const auto endpoint = std::string{"inproc://reopen"};
+    auto ec = boost::system::error_code{};
+    int timestamp;
+    double a0, a1, a2;
+
+    std::unique_ptr<barobo::Simulator> sim { new barobo::Simulator{endpoint} };
+    barobo::Linkbot first { endpoint };
+    first.getJointAngles(timestamp, a0, a1, a2, ec);
+    check(!ec, "first connection");
+
+    // The robot goes away, and comes back under the same name.
+    sim.reset();
+    sim.reset(new barobo::Simulator{endpoint});
+
+    // The old connection notices its end on its I/O thread; give it a moment.
+    auto reopened = false;
+    for (int i = 0; i < 20 && !reopened; ++i) {
+        barobo::Linkbot second { endpoint };
+        second.getJointAngles(timestamp, a0, a1, a2, ec);
+        reopened = !ec;
+        if (!reopened) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    check(reopened, "reopen after disconnect");
+
+    first.getJointAngles(timestamp, a0, a1, a2, ec);
+    check(!!ec, "old handle stays disconnected");
+
+    std::atomic<int> errors{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&endpoint, &errors] {
+            for (int i = 0; i < 50; ++i) {
+                try {
+                    barobo::Linkbot linkbot { endpoint };
+                    int timestamp;
+                    double a0, a1, a2;
+                    auto ec = boost::system::error_code{};
+                    linkbot.getJointAngles(timestamp, a0, a1, a2, ec);
+                    if (ec) {
+                        ++errors;
+                    }
+                }
+                catch (std::exception&) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    check(0 == errors, "concurrent open and close");
+
+    return report("reopen");
+}
@@ -0,0 +1,66 @@
+// Check the k-way merge's ordering, window and late-event handling.
+#include "reorderbuffer.hpp"
+#include "check.hpp"
+
+using baromesh::ReorderBuffer;
+
+int main () {
+    int e;
+    int64_t t;
+
+    ReorderBuffer<int> b{1000, 8};
+    auto s0 = b.addSource();
+    auto s1 = b.addSource();
+    auto s2 = b.addSource();
+
+    b.push(s0, 100, 0);
+    b.push(s0, 300, 1);
+    b.push(s1, 200, 2);
+    check(!b.pop(0, e, t), "waits for a silent source");
+    check(1100 == b.deadline(), "deadline is the window past the oldest event");
+
+    // Once every source has spoken, events up to the slowest one's newest
+    // are in order.
+    b.push(s2, 250, 3);
+    check(b.pop(0, e, t) && 0 == e && 100 == t, "oldest first");
+    check(b.pop(0, e, t) && 2 == e && 200 == t, "merges across sources");
+    check(!b.pop(0, e, t), "holds events newer than the slowest source");
+
+    // The window releases them anyway.
+    check(!b.pop(1249, e, t), "not before the window");
+    check(b.pop(1250, e, t) && 3 == e, "released by the window");
+    check(b.pop(1300, e, t) && 1 == e, "in time order");
+
+    // Late events are dropped.
+    check(!b.push(s1, 250, 4), "late event dropped");
+    check(1 == b.late(), "late event counted");
+
+    // A source's events stay in order even if their times do not.
+    b.push(s1, 400, 5);
+    b.push(s1, 390, 6);
+    b.push(s0, 500, 7);
+    b.push(s2, 500, 8);
+    check(b.pop(0, e, t) && 5 == e, "source order kept");
+    check(b.pop(0, e, t) && 6 == e && 400 == t, "out-of-order time clamped");
+
+    // A removed source no longer holds the merge back, but its events are
+    // still released.
+    b.push(s0, 600, 9);
+    b.removeSource(s2);
+    check(!b.pop(0, e, t), "still waits for live sources");
+    b.push(s1, 700, 10);
+    check(b.pop(0, e, t) && 7 == e, "ties broken by source");
+    check(b.pop(0, e, t) && 8 == e, "removed source's events released");
+    check(b.pop(0, e, t) && 9 == e, "removed source does not block");
+    check(!b.pop(0, e, t), "waits for the slowest live source");
+
+    // Capacity bounds the queue.
+    ReorderBuffer<int> small{1000, 2};
+    auto a = small.addSource();
+    small.addSource();
+    small.push(a, 1, 0);
+    small.push(a, 2, 0);
+    check(!small.push(a, 3, 0) && 1 == small.overflowed(), "overflow dropped and counted");
+
+    return report("reorderbuffer");
+}
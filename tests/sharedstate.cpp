@@ -0,0 +1,103 @@
+// Check the shared-state exporter: the sequence lock never hands a reader a
+// torn value, a reader sees what the exporter published, a live exporter's
+// name is refused, and a dead exporter's region is replaced.
+#include "baromesh/error.hpp"
+#include "baromesh/linkbot.hpp"
+#include "baromesh/sharedstate.hpp"
+#include "baromesh/simulator.hpp"
+#include "seqlock.hpp"
+#include "check.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct Words {
+    uint64_t w[16];
+};
+
+// One writer fills every word with the same count while a reader checks each
+// snapshot for a mix of two writes.
+void seqlock () {
+    baromesh::SeqLock<Words> lock{};
+    std::atomic<bool> done{false};
+    std::thread writer { [&lock, &done] {
+        for (uint64_t i = 1; i <= 200000; ++i) {
+            lock.write([i] (Words& v) {
+                for (auto& w : v.w) {
+                    w = i;
+                }
+            });
+        }
+        done = true;
+    } };
+    auto torn = 0;
+    auto backward = 0;
+    uint64_t last = 0;
+    while (!done) {
+        Words v;
+        lock.read(v);
+        for (auto w : v.w) {
+            torn += w != v.w[0];
+        }
+        backward += v.w[0] < last;
+        last = v.w[0];
+    }
+    writer.join();
+    check(!torn, "seqlock reads are never torn");
+    check(!backward, "seqlock reads never go back in time");
+    check(200000 == lock.version(), "seqlock counts writes");
+}
+
+int main () {
+    auto name = "sharedstate-test-" + std::to_string(getpid());
+
+    // An exporter which dies without cleaning up leaves its region behind.
+    // Fork before this process has any threads.
+    auto child = fork();
+    if (!child) {
+        barobo::Simulator sim { "inproc://sharedstate-child" };
+        barobo::Linkbot linkbot { sim.endpoint() };
+        new barobo::SharedStateExporter{linkbot, name};
+        _exit(0);
+    }
+    auto status = 0;
+    waitpid(child, &status, 0);
+    check(WIFEXITED(status) && 0 == WEXITSTATUS(status), "dead exporter ran");
+
+    seqlock();
+
+    barobo::Simulator sim { "inproc://sharedstate" };
+    barobo::Linkbot linkbot { sim.endpoint() };
+    try {
+        barobo::SharedStateExporter exporter { linkbot, name };
+
+        auto refused = false;
+        try {
+            barobo::SharedStateExporter second { linkbot, name };
+        }
+        catch (barobo::Error&) {
+            refused = true;
+        }
+        check(refused, "live exporter's name refused");
+
+        barobo::SharedStateReader reader { name };
+        auto before = reader.version();
+        int timestamp;
+        double a0, a1, a2;
+        linkbot.getJointAngles(timestamp, a0, a1, a2);
+        barobo::SharedRobotState state;
+        reader.read(state);
+        check(reader.version() > before, "getter publishes an update");
+        check(timestamp == state.jointAnglesTimestamp[0] && a0 == state.jointAngles[0]
+              && a2 == state.jointAngles[2], "reader sees the getter's reply");
+    }
+    catch (barobo::Error& e) {
+        check(false, e.what());
+    }
+
+    return report("sharedstate");
+}